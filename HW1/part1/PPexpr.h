@@ -0,0 +1,391 @@
+#ifndef PPEXPR_H_
+#define PPEXPR_H_
+
+// Expression-template front end for PPintrin.h. Elementwise chains such as
+//
+//   pp::vec<float> a = x * y - z;
+//   pp::store(output + i, pp::load(values + i) * 2.f, mask);
+//
+// build a tree of small objects at compile time and are evaluated in one lane
+// loop (one register sequence per chunk with -DPP_NATIVE), so no __pp_vec
+// temporary is written between the steps. Evaluation still logs every
+// logical instruction (vload, vset, vadd, ..., vstore) with the active mask,
+// in the order the unfused intrinsics would have run, so the statistics and
+// the machine model see the same instruction stream.
+//
+// Only lane-wise operations fuse: + - * / (/ is float only), pp::min,
+// pp::max and pp::abs. A pp::vec converts to __pp_vec<T, W>& so it can be
+// passed to any intrinsic.
+
+#include <type_traits>
+#include "PPintrin.h"
+
+namespace pp
+{
+
+template <typename T, int W = VECTOR_WIDTH>
+class vec;
+
+// Base of every expression node, E is the node type
+template <typename E>
+struct expr
+{
+  const E &self() const { return static_cast<const E &>(*this); }
+};
+
+// Nodes hold their operands by value, except vec leaves which are held by
+// reference
+template <typename E>
+struct operand
+{
+  typedef E type;
+};
+
+template <typename T, int W>
+struct operand<vec<T, W>>
+{
+  typedef const vec<T, W> &type;
+};
+
+#ifdef PP_NATIVE
+template <typename T, int W>
+using native = __pp_native<T, __pp_lanes<W>::value>;
+#endif
+
+//**************
+//* Operations *
+//**************
+
+// name is the logged instruction, lane() is the emulated lane operation and
+// chunk() the native register operation
+
+struct op_add
+{
+  static constexpr const char *name = "vadd";
+  template <typename T>
+  static T lane(T a, T b) { return a + b; }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a, typename R::reg b) { return R::add(a, b); }
+#endif
+};
+
+struct op_sub
+{
+  static constexpr const char *name = "vsub";
+  template <typename T>
+  static T lane(T a, T b) { return a - b; }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a, typename R::reg b) { return R::sub(a, b); }
+#endif
+};
+
+struct op_mult
+{
+  static constexpr const char *name = "vmult";
+  template <typename T>
+  static T lane(T a, T b) { return a * b; }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a, typename R::reg b) { return R::mul(a, b); }
+#endif
+};
+
+struct op_div
+{
+  static constexpr const char *name = "vdiv";
+  template <typename T>
+  static T lane(T a, T b) { return a / b; }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a, typename R::reg b) { return R::div(a, b); }
+#endif
+};
+
+// Same lane choice as _pp_vmin / _pp_vmax
+struct op_min
+{
+  static constexpr const char *name = "vmin";
+  template <typename T>
+  static T lane(T a, T b) { return a < b ? a : b; }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a, typename R::reg b) { return R::min(a, b); }
+#endif
+};
+
+struct op_max
+{
+  static constexpr const char *name = "vmax";
+  template <typename T>
+  static T lane(T a, T b) { return a > b ? a : b; }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a, typename R::reg b) { return R::max(a, b); }
+#endif
+};
+
+struct op_abs
+{
+  static constexpr const char *name = "vabs";
+  template <typename T>
+  static T lane(T a) { return std::abs(a); }
+#ifdef PP_NATIVE
+  template <typename R>
+  static typename R::reg chunk(typename R::reg a) { return R::abs(a); }
+#endif
+};
+
+//*********
+//* Nodes *
+//*********
+
+// Every node provides lane(i) (emulated) or chunk(c, m) (native), id() which
+// stands for its register in the machine model, and log(), which logs the
+// instructions of its subtree in evaluation order, the root writing to dest.
+
+// A broadcast scalar, logged as vset
+template <typename T, int W>
+struct scalar : expr<scalar<T, W>>
+{
+  typedef T value_type;
+  static constexpr int width = W;
+  T value;
+
+  explicit scalar(T value) : value(value) {}
+  T lane(int i) const { return value; }
+#ifdef PP_NATIVE
+  typename native<T, W>::reg chunk(int c, typename native<T, W>::mask m) const { return native<T, W>::set1(value); }
+#endif
+  const void *id() const { return this; }
+  void log(const __pp_mask_w<W> &mask, const __pp_site &site, const void *dest) const
+  {
+    PP_LOG("vset", mask.bits, W, site, __pp_deps(dest, &mask));
+  }
+};
+
+// W consecutive elements of an array, logged as vload
+template <typename T, int W>
+struct load_expr : expr<load_expr<T, W>>
+{
+  typedef T value_type;
+  static constexpr int width = W;
+  const T *src;
+
+  explicit load_expr(const T *src) : src(src) {}
+  T lane(int i) const { return src[i]; }
+#ifdef PP_NATIVE
+  typename native<T, W>::reg chunk(int c, typename native<T, W>::mask m) const { return native<T, W>::maskload(src + c, m); }
+#endif
+  const void *id() const { return this; }
+  void log(const __pp_mask_w<W> &mask, const __pp_site &site, const void *dest) const
+  {
+    PP_LOG("vload", mask.bits, W, site, __pp_deps(dest, &mask));
+  }
+};
+
+template <typename Op, typename L, typename R>
+struct binary : expr<binary<Op, L, R>>
+{
+  typedef typename L::value_type value_type;
+  static constexpr int width = L::width;
+  static_assert(std::is_same<value_type, typename R::value_type>::value, "pp: operands of different types");
+  static_assert(L::width == R::width, "pp: operands of different widths");
+  typename operand<L>::type l;
+  typename operand<R>::type r;
+
+  binary(const L &l, const R &r) : l(l), r(r) {}
+  value_type lane(int i) const { return Op::lane(l.lane(i), r.lane(i)); }
+#ifdef PP_NATIVE
+  typedef native<value_type, width> N;
+  typename N::reg chunk(int c, typename N::mask m) const { return Op::template chunk<N>(l.chunk(c, m), r.chunk(c, m)); }
+#endif
+  const void *id() const { return this; }
+  void log(const __pp_mask_w<width> &mask, const __pp_site &site, const void *dest) const
+  {
+    l.log(mask, site, l.id());
+    r.log(mask, site, r.id());
+    PP_LOG(Op::name, mask.bits, width, site, __pp_deps(dest, l.id(), r.id(), &mask));
+  }
+};
+
+template <typename Op, typename A>
+struct unary : expr<unary<Op, A>>
+{
+  typedef typename A::value_type value_type;
+  static constexpr int width = A::width;
+  typename operand<A>::type a;
+
+  explicit unary(const A &a) : a(a) {}
+  value_type lane(int i) const { return Op::lane(a.lane(i)); }
+#ifdef PP_NATIVE
+  typedef native<value_type, width> N;
+  typename N::reg chunk(int c, typename N::mask m) const { return Op::template chunk<N>(a.chunk(c, m)); }
+#endif
+  const void *id() const { return this; }
+  void log(const __pp_mask_w<width> &mask, const __pp_site &site, const void *dest) const
+  {
+    a.log(mask, site, a.id());
+    PP_LOG(Op::name, mask.bits, width, site, __pp_deps(dest, a.id(), &mask));
+  }
+};
+
+// Evaluate e on the active lanes of mask, out(i, value) receives lane i
+// (emulated) or out(c, reg, m) the chunk at lane c (native)
+template <typename E, int W, typename Out>
+inline void eval(const E &e, const __pp_mask_w<W> &mask, Out out)
+{
+#ifdef PP_NATIVE
+  __pp_native_chunks(mask, [&](int c, typename native<typename E::value_type, W>::mask m) {
+    out(c, e.chunk(c, m), m);
+  });
+#else
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      out(i, e.lane(i));
+  }
+#endif
+}
+
+//**********
+//* Vector *
+//**********
+
+// A vector register that expressions can be assigned to. Assigning an
+// expression writes the active lanes and keeps the others.
+template <typename T, int W>
+class vec : public expr<vec<T, W>>
+{
+  public:
+    typedef T value_type;
+    static constexpr int width = W;
+    __pp_vec<T, W> v;
+
+    vec() : v() {}
+    vec(const __pp_vec<T, W> &v) : v(v) {}
+    template <typename E>
+    vec(const expr<E> &e, __pp_site site = __pp_site()) : v()
+    {
+      assign(e, _pp_init_ones<W>(), site);
+    }
+
+    // operator= cannot take the call site, so profiles attribute it to this
+    // file; use assign() to keep the caller's line
+    template <typename E>
+    vec &operator=(const expr<E> &e)
+    {
+      assign(e, _pp_init_ones<W>());
+      return *this;
+    }
+
+    template <typename E>
+    void assign(const expr<E> &e, const __pp_mask_w<W> &mask, __pp_site site = __pp_site())
+    {
+      const E &root = e.self();
+      static_assert(E::width == W, "pp: assigning an expression of a different width");
+      root.log(mask, site, &v);
+#ifdef PP_NATIVE
+      typedef native<T, W> N;
+      eval(root, mask, [&](int c, typename N::reg x, typename N::mask m) {
+        N::store(v.value + c, N::blend(N::load(v.value + c), x, m));
+      });
+#else
+      eval(root, mask, [&](int i, T x) { v.value[i] = x; });
+#endif
+    }
+
+    operator __pp_vec<T, W> &() { return v; }
+    T &operator[](int i) { return v.value[i]; }
+    T operator[](int i) const { return v.value[i]; }
+
+    // As a leaf of an expression: no instruction, the register is read as is
+    T lane(int i) const { return v.value[i]; }
+#ifdef PP_NATIVE
+    typename native<T, W>::reg chunk(int c, typename native<T, W>::mask m) const { return native<T, W>::load(v.value + c); }
+#endif
+    const void *id() const { return &v; }
+    void log(const __pp_mask_w<W> &mask, const __pp_site &site, const void *dest) const {}
+};
+
+//*************
+//* Functions *
+//*************
+
+// Read W elements starting at src
+template <int W = VECTOR_WIDTH, typename T>
+inline load_expr<T, W> load(const T *src)
+{
+  return load_expr<T, W>(src);
+}
+
+// Write the active lanes of e to dest, the whole chain runs in one loop
+template <typename T, typename E>
+inline void store(T *dest, const expr<E> &e, const __pp_mask_w<E::width> &mask, __pp_site site = __pp_site())
+{
+  const E &root = e.self();
+  root.log(mask, site, root.id());
+  PP_LOG("vstore", mask.bits, E::width, site, __pp_deps(NULL, root.id(), &mask));
+#ifdef PP_NATIVE
+  typedef native<T, E::width> N;
+  eval(root, mask, [&](int c, typename N::reg x, typename N::mask m) { N::maskstore(dest + c, x, m); });
+#else
+  eval(root, mask, [&](int i, T x) { dest[i] = x; });
+#endif
+}
+
+template <typename A>
+inline unary<op_abs, A> abs(const expr<A> &a)
+{
+  return unary<op_abs, A>(a.self());
+}
+
+// Binary operators on two expressions, or an expression and a scalar that
+// is broadcast with a vset
+#define PP_EXPR_BINARY(FN, OP)                                                                            \
+  template <typename L, typename R>                                                                       \
+  inline binary<OP, L, R> FN(const expr<L> &l, const expr<R> &r)                                          \
+  {                                                                                                       \
+    return binary<OP, L, R>(l.self(), r.self());                                                          \
+  }                                                                                                       \
+  template <typename L>                                                                                   \
+  inline binary<OP, L, scalar<typename L::value_type, L::width>> FN(const expr<L> &l,                     \
+                                                                    typename L::value_type r)             \
+  {                                                                                                       \
+    return binary<OP, L, scalar<typename L::value_type, L::width>>(                                       \
+        l.self(), scalar<typename L::value_type, L::width>(r));                                           \
+  }                                                                                                       \
+  template <typename R>                                                                                   \
+  inline binary<OP, scalar<typename R::value_type, R::width>, R> FN(typename R::value_type l,             \
+                                                                    const expr<R> &r)                     \
+  {                                                                                                       \
+    return binary<OP, scalar<typename R::value_type, R::width>, R>(                                       \
+        scalar<typename R::value_type, R::width>(l), r.self());                                           \
+  }
+
+PP_EXPR_BINARY(operator+, op_add)
+PP_EXPR_BINARY(operator-, op_sub)
+PP_EXPR_BINARY(operator*, op_mult)
+PP_EXPR_BINARY(min, op_min)
+PP_EXPR_BINARY(max, op_max)
+
+// x86 has no packed integer division, so / only fuses float chains
+template <typename L, typename R>
+inline binary<op_div, L, R> operator/(const expr<L> &l, const expr<R> &r)
+{
+  static_assert(std::is_same<typename L::value_type, float>::value, "pp: / is only fused for float");
+  return binary<op_div, L, R>(l.self(), r.self());
+}
+template <typename L>
+inline binary<op_div, L, scalar<float, L::width>> operator/(const expr<L> &l, float r)
+{
+  static_assert(std::is_same<typename L::value_type, float>::value, "pp: / is only fused for float");
+  return binary<op_div, L, scalar<float, L::width>>(l.self(), scalar<float, L::width>(r));
+}
+
+#undef PP_EXPR_BINARY
+
+} // namespace pp
+
+#endif
@@ -5,300 +5,632 @@
 //* Implementation *
 //******************
 
-__pp_mask _pp_init_ones(int first)
+// Lane-by-lane bodies of the instructions. The emulator runs every element
+// type on them, the native backend only the types it has no registers for.
+namespace __pp_generic
 {
-  __pp_mask mask;
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+
+template <int W>
+static unsigned long long allBits()
+{
+  return ~0ULL >> (64 - W);
+}
+
+template <int W>
+static inline bool lane(const __pp_mask_w<W> &mask, int i)
+{
+  return (mask.bits >> i) & 1;
+}
+
+template <typename T, int W>
+void _pp_vset(__pp_vec<T, W> &vecResult, T value, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
   {
-    mask.value[i] = (i < first) ? true : false;
+    vecResult.value[i] = lane(mask, i) ? value : vecResult.value[i];
   }
-  return mask;
+  PP_LOG("vset", mask.bits, W, site, __pp_deps(&vecResult, &mask), sizeof(T));
 }
 
-__pp_mask _pp_mask_not(__pp_mask &maska)
+template <typename T, int W>
+void _pp_vmove(__pp_vec<T, W> &dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
 {
-  __pp_mask resultMask;
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    resultMask.value[i] = !maska.value[i];
+    dest.value[i] = lane(mask, i) ? src.value[i] : dest.value[i];
   }
-  PPLogger.addLog("masknot", _pp_init_ones(), VECTOR_WIDTH);
-  return resultMask;
+  PP_LOG("vmove", mask.bits, W, site, __pp_deps(&dest, &src, &mask), sizeof(T));
 }
 
-__pp_mask _pp_mask_or(__pp_mask &maska, __pp_mask &maskb)
+template <typename T, int W>
+void _pp_vload(__pp_vec<T, W> &dest, T *src, __pp_mask_w<W> &mask, __pp_site site)
 {
-  __pp_mask resultMask;
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    resultMask.value[i] = maska.value[i] | maskb.value[i];
+    dest.value[i] = lane(mask, i) ? src[i] : dest.value[i];
   }
-  PPLogger.addLog("maskor", _pp_init_ones(), VECTOR_WIDTH);
-  return resultMask;
+  PP_LOG("vload", mask.bits, W, site, __pp_deps(&dest, &mask), sizeof(T));
 }
 
-__pp_mask _pp_mask_and(__pp_mask &maska, __pp_mask &maskb)
+template <typename T, int W>
+void _pp_vstore(T *dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
 {
-  __pp_mask resultMask;
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    resultMask.value[i] = maska.value[i] && maskb.value[i];
+    if (lane(mask, i))
+      dest[i] = src.value[i];
   }
-  PPLogger.addLog("maskand", _pp_init_ones(), VECTOR_WIDTH);
-  return resultMask;
+  PP_LOG("vstore", mask.bits, W, site, __pp_deps(NULL, &src, &mask), sizeof(T));
 }
 
-int _pp_cntbits(__pp_mask &maska)
+template <typename T, int W>
+void _pp_vadd(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  int count = 0;
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    if (maska.value[i])
-      count++;
+    vecResult.value[i] = lane(mask, i) ? (veca.value[i] + vecb.value[i]) : vecResult.value[i];
   }
-  PPLogger.addLog("cntbits", _pp_init_ones(), VECTOR_WIDTH);
-  return count;
+  PP_LOG("vadd", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template <typename T>
-void _pp_vset(__pp_vec<T> &vecResult, T value, __pp_mask &mask)
+template <typename T, int W>
+void _pp_vsub(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    vecResult.value[i] = mask.value[i] ? value : vecResult.value[i];
+    vecResult.value[i] = lane(mask, i) ? (veca.value[i] - vecb.value[i]) : vecResult.value[i];
   }
-  PPLogger.addLog("vset", mask, VECTOR_WIDTH);
+  PP_LOG("vsub", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template void _pp_vset<float>(__pp_vec_float &vecResult, float value, __pp_mask &mask);
-template void _pp_vset<int>(__pp_vec_int &vecResult, int value, __pp_mask &mask);
-
-void _pp_vset_float(__pp_vec_float &vecResult, float value, __pp_mask &mask) { _pp_vset<float>(vecResult, value, mask); }
-void _pp_vset_int(__pp_vec_int &vecResult, int value, __pp_mask &mask) { _pp_vset<int>(vecResult, value, mask); }
-
-__pp_vec_float _pp_vset_float(float value)
+template <typename T, int W>
+void _pp_vmult(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  __pp_vec_float vecResult;
-  __pp_mask mask = _pp_init_ones();
-  _pp_vset_float(vecResult, value, mask);
-  return vecResult;
+  for (int i = 0; i < W; i++)
+  {
+    vecResult.value[i] = lane(mask, i) ? (veca.value[i] * vecb.value[i]) : vecResult.value[i];
+  }
+  PP_LOG("vmult", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask), sizeof(T));
 }
-__pp_vec_int _pp_vset_int(int value)
+
+template <typename T, int W>
+void _pp_vdiv(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  __pp_vec_int vecResult;
-  __pp_mask mask = _pp_init_ones();
-  _pp_vset_int(vecResult, value, mask);
-  return vecResult;
+  for (int i = 0; i < W; i++)
+  {
+    vecResult.value[i] = lane(mask, i) ? (veca.value[i] / vecb.value[i]) : vecResult.value[i];
+  }
+  PP_LOG("vdiv", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template <typename T>
-void _pp_vmove(__pp_vec<T> &dest, __pp_vec<T> &src, __pp_mask &mask)
+template <typename T, int W>
+void _pp_vabs(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    dest.value[i] = mask.value[i] ? src.value[i] : dest.value[i];
+    vecResult.value[i] = lane(mask, i) ? (abs(veca.value[i])) : vecResult.value[i];
   }
-  PPLogger.addLog("vmove", mask, VECTOR_WIDTH);
+  PP_LOG("vabs", mask.bits, W, site, __pp_deps(&vecResult, &veca, &mask), sizeof(T));
 }
 
-template void _pp_vmove<float>(__pp_vec_float &dest, __pp_vec_float &src, __pp_mask &mask);
-template void _pp_vmove<int>(__pp_vec_int &dest, __pp_vec_int &src, __pp_mask &mask);
-
-void _pp_vmove_float(__pp_vec_float &dest, __pp_vec_float &src, __pp_mask &mask) { _pp_vmove<float>(dest, src, mask); }
-void _pp_vmove_int(__pp_vec_int &dest, __pp_vec_int &src, __pp_mask &mask) { _pp_vmove<int>(dest, src, mask); }
-
-template <typename T>
-void _pp_vload(__pp_vec<T> &dest, T *src, __pp_mask &mask)
+template <typename T, int W>
+void _pp_vgt(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  unsigned long long result = 0;
+  for (int i = 0; i < W; i++)
   {
-    dest.value[i] = mask.value[i] ? src[i] : dest.value[i];
+    result |= (unsigned long long)(veca.value[i] > vecb.value[i]) << i;
   }
-  PPLogger.addLog("vload", mask, VECTOR_WIDTH);
+  maskResult.bits = (maskResult.bits & ~mask.bits) | (result & mask.bits);
+  PP_LOG("vgt", mask.bits, W, site, __pp_deps(&maskResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template void _pp_vload<float>(__pp_vec_float &dest, float *src, __pp_mask &mask);
-template void _pp_vload<int>(__pp_vec_int &dest, int *src, __pp_mask &mask);
-
-void _pp_vload_float(__pp_vec_float &dest, float *src, __pp_mask &mask) { _pp_vload<float>(dest, src, mask); }
-void _pp_vload_int(__pp_vec_int &dest, int *src, __pp_mask &mask) { _pp_vload<int>(dest, src, mask); }
-
-template <typename T>
-void _pp_vstore(T *dest, __pp_vec<T> &src, __pp_mask &mask)
+template <typename T, int W>
+void _pp_vlt(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  unsigned long long result = 0;
+  for (int i = 0; i < W; i++)
   {
-    dest[i] = mask.value[i] ? src.value[i] : dest[i];
+    result |= (unsigned long long)(veca.value[i] < vecb.value[i]) << i;
   }
-  PPLogger.addLog("vstore", mask, VECTOR_WIDTH);
+  maskResult.bits = (maskResult.bits & ~mask.bits) | (result & mask.bits);
+  PP_LOG("vlt", mask.bits, W, site, __pp_deps(&maskResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template void _pp_vstore<float>(float *dest, __pp_vec_float &src, __pp_mask &mask);
-template void _pp_vstore<int>(int *dest, __pp_vec_int &src, __pp_mask &mask);
-
-void _pp_vstore_float(float *dest, __pp_vec_float &src, __pp_mask &mask) { _pp_vstore<float>(dest, src, mask); }
-void _pp_vstore_int(int *dest, __pp_vec_int &src, __pp_mask &mask) { _pp_vstore<int>(dest, src, mask); }
-
-template <typename T>
-void _pp_vadd(__pp_vec<T> &vecResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <typename T, int W>
+void _pp_veq(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  unsigned long long result = 0;
+  for (int i = 0; i < W; i++)
   {
-    vecResult.value[i] = mask.value[i] ? (veca.value[i] + vecb.value[i]) : vecResult.value[i];
+    result |= (unsigned long long)(veca.value[i] == vecb.value[i]) << i;
   }
-  PPLogger.addLog("vadd", mask, VECTOR_WIDTH);
+  maskResult.bits = (maskResult.bits & ~mask.bits) | (result & mask.bits);
+  PP_LOG("veq", mask.bits, W, site, __pp_deps(&maskResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template void _pp_vadd<float>(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_vadd<int>(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
-
-void _pp_vadd_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_vadd<float>(vecResult, veca, vecb, mask); }
-void _pp_vadd_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_vadd<int>(vecResult, veca, vecb, mask); }
-
-template <typename T>
-void _pp_vsub(__pp_vec<T> &vecResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <typename T, int W>
+void _pp_hadd(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &vec, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W / 2; i++)
   {
-    vecResult.value[i] = mask.value[i] ? (veca.value[i] - vecb.value[i]) : vecResult.value[i];
+    T result = vec.value[2 * i] + vec.value[2 * i + 1];
+    vecResult.value[2 * i] = result;
+    vecResult.value[2 * i + 1] = result;
   }
-  PPLogger.addLog("vsub", mask, VECTOR_WIDTH);
+  PP_LOG("hadd", allBits<W>(), W, site, __pp_deps(&vecResult, &vec), sizeof(T));
 }
 
-template void _pp_vsub<float>(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_vsub<int>(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
-
-void _pp_vsub_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_vsub<float>(vecResult, veca, vecb, mask); }
-void _pp_vsub_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_vsub<int>(vecResult, veca, vecb, mask); }
-
-template <typename T>
-void _pp_vmult(__pp_vec<T> &vecResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <typename T, int W>
+void _pp_interleave(__pp_vec<T, W> &vecResult, __pp_vec<T, W> vec, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    vecResult.value[i] = mask.value[i] ? (veca.value[i] * vecb.value[i]) : vecResult.value[i];
+    int index = i < (W + 1) / 2 ? (2 * i) : (2 * (i - (W + 1) / 2) + 1);
+    vecResult.value[i] = vec.value[index];
   }
-  PPLogger.addLog("vmult", mask, VECTOR_WIDTH);
+  PP_LOG("interleave", allBits<W>(), W, site, __pp_deps(&vecResult), sizeof(T));
 }
 
-template void _pp_vmult<float>(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_vmult<int>(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
-
-void _pp_vmult_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_vmult<float>(vecResult, veca, vecb, mask); }
-void _pp_vmult_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_vmult<int>(vecResult, veca, vecb, mask); }
-
-template <typename T>
-void _pp_vdiv(__pp_vec<T> &vecResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <typename T, typename Acc = T, int W>
+Acc _pp_hreduce_add(__pp_vec<T, W> &vec, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  Acc sum = 0;
+  for (int i = 0; i < W; i++)
   {
-    vecResult.value[i] = mask.value[i] ? (veca.value[i] / vecb.value[i]) : vecResult.value[i];
+    if (lane(mask, i))
+      sum += vec.value[i];
   }
-  PPLogger.addLog("vdiv", mask, VECTOR_WIDTH);
+  PP_LOG("hreduce", mask.bits, W, site, __pp_deps(NULL, &vec, &mask), sizeof(T));
+  return sum;
 }
 
-template void _pp_vdiv<float>(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_vdiv<int>(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <typename T, int W>
+void _pp_vpermute(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site)
+{
+  // vecResult may be vec
+  __pp_vec<T, W> src = vec;
+  for (int i = 0; i < W; i++)
+  {
+    vecResult.value[i] = lane(mask, i) ? src.value[index.value[i]] : vecResult.value[i];
+  }
+  PP_LOG("vpermute", mask.bits, W, site, __pp_deps(&vecResult, &vec, &index, &mask), sizeof(T));
+}
 
-void _pp_vdiv_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_vdiv<float>(vecResult, veca, vecb, mask); }
-void _pp_vdiv_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_vdiv<int>(vecResult, veca, vecb, mask); }
+template <typename T, int W>
+void _pp_vbroadcast(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site)
+{
+  T value = vec.value[lane];
+  for (int i = 0; i < W; i++)
+  {
+    vecResult.value[i] = __pp_generic::lane(mask, i) ? value : vecResult.value[i];
+  }
+  PP_LOG("vbroadcast", mask.bits, W, site, __pp_deps(&vecResult, &vec, &mask), sizeof(T));
+}
 
-template <typename T>
-void _pp_vabs(__pp_vec<T> &vecResult, __pp_vec<T> &veca, __pp_mask &mask)
+template <typename T, int W>
+void _pp_vmin(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    vecResult.value[i] = mask.value[i] ? (abs(veca.value[i])) : vecResult.value[i];
+    vecResult.value[i] = lane(mask, i) ? (veca.value[i] < vecb.value[i] ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
   }
-  PPLogger.addLog("vabs", mask, VECTOR_WIDTH);
+  PP_LOG("vmin", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask), sizeof(T));
 }
 
-template void _pp_vabs<float>(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_mask &mask);
-template void _pp_vabs<int>(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_mask &mask);
+template <typename T, int W>
+void _pp_vmax(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
+  {
+    vecResult.value[i] = lane(mask, i) ? (veca.value[i] > vecb.value[i] ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
+  }
+  PP_LOG("vmax", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask), sizeof(T));
+}
 
-void _pp_vabs_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_mask &mask) { _pp_vabs<float>(vecResult, veca, mask); }
-void _pp_vabs_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_mask &mask) { _pp_vabs<int>(vecResult, veca, mask); }
+template <typename T, int W>
+void _pp_vselect(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
+  {
+    vecResult.value[i] = lane(mask, i) ? (lane(sel, i) ? veca.value[i] : vecb.value[i]) : vecResult.value[i];
+  }
+  PP_LOG("vselect", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &sel, &mask), sizeof(T));
+}
 
-template <typename T>
-void _pp_vgt(__pp_mask &maskResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <typename T, int W>
+void _pp_vgather(__pp_vec<T, W> &dest, T *base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  for (int i = 0; i < W; i++)
   {
-    maskResult.value[i] = mask.value[i] ? (veca.value[i] > vecb.value[i]) : maskResult.value[i];
+    dest.value[i] = lane(mask, i) ? base[index.value[i]] : dest.value[i];
   }
-  PPLogger.addLog("vgt", mask, VECTOR_WIDTH);
+  PP_LOG("vgather", mask.bits, W, site, __pp_deps(&dest, &index, &mask), sizeof(T));
 }
 
-template void _pp_vgt<float>(__pp_mask &maskResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_vgt<int>(__pp_mask &maskResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <typename T, int W>
+void _pp_vscatter(T *base, __pp_vec<int, W> &index, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if (lane(mask, i))
+      base[index.value[i]] = src.value[i];
+  }
+  PP_LOG("vscatter", mask.bits, W, site, __pp_deps(NULL, &index, &src, &mask), sizeof(T));
+}
 
-void _pp_vgt_float(__pp_mask &maskResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_vgt<float>(maskResult, veca, vecb, mask); }
-void _pp_vgt_int(__pp_mask &maskResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_vgt<int>(maskResult, veca, vecb, mask); }
+template <typename T, int W>
+int _pp_vcompress(T *dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  int count = 0;
+  for (int i = 0; i < W; i++)
+  {
+    if (lane(mask, i))
+      dest[count++] = src.value[i];
+  }
+  PP_LOG("vcompress", mask.bits, W, site, __pp_deps(NULL, &src, &mask), sizeof(T));
+  return count;
+}
 
-template <typename T>
-void _pp_vlt(__pp_mask &maskResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <typename T, int W>
+int _pp_vexpand(__pp_vec<T, W> &dest, T *src, __pp_mask_w<W> &mask, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  int count = 0;
+  for (int i = 0; i < W; i++)
   {
-    maskResult.value[i] = mask.value[i] ? (veca.value[i] < vecb.value[i]) : maskResult.value[i];
+    if (lane(mask, i))
+      dest.value[i] = src[count++];
   }
-  PPLogger.addLog("vlt", mask, VECTOR_WIDTH);
+  PP_LOG("vexpand", mask.bits, W, site, __pp_deps(&dest, &mask), sizeof(T));
+  return count;
 }
 
-template void _pp_vlt<float>(__pp_mask &maskResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_vlt<int>(__pp_mask &maskResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+} // namespace __pp_generic
+
+// The native backend defines the float, int and mask functions inline in
+// PPintrin_native.h
+#ifndef PP_NATIVE
 
-void _pp_vlt_float(__pp_mask &maskResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_vlt<float>(maskResult, veca, vecb, mask); }
-void _pp_vlt_int(__pp_mask &maskResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_vlt<int>(maskResult, veca, vecb, mask); }
+using namespace __pp_generic;
 
-template <typename T>
-void _pp_veq(__pp_mask &maskResult, __pp_vec<T> &veca, __pp_vec<T> &vecb, __pp_mask &mask)
+template <int W>
+__pp_mask_w<W> _pp_init_ones(int first)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
-  {
-    maskResult.value[i] = mask.value[i] ? (veca.value[i] == vecb.value[i]) : maskResult.value[i];
-  }
-  PPLogger.addLog("veq", mask, VECTOR_WIDTH);
+  __pp_mask_w<W> mask;
+  mask.bits = first >= W ? allBits<W>() : first > 0 ? (1ULL << first) - 1 : 0;
+  return mask;
 }
 
-template void _pp_veq<float>(__pp_mask &maskResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-template void _pp_veq<int>(__pp_mask &maskResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+// The result is returned by value, so no destination is recorded (see
+// machine_model.h)
+template <int W>
+__pp_mask_w<W> _pp_mask_not(__pp_mask_w<W> &maska, __pp_site site)
+{
+  __pp_mask_w<W> resultMask;
+  resultMask.bits = ~maska.bits & allBits<W>();
+  PP_LOG("masknot", allBits<W>(), W, site, __pp_deps(NULL, &maska));
+  return resultMask;
+}
 
-void _pp_veq_float(__pp_mask &maskResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask) { _pp_veq<float>(maskResult, veca, vecb, mask); }
-void _pp_veq_int(__pp_mask &maskResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask) { _pp_veq<int>(maskResult, veca, vecb, mask); }
+template <int W>
+__pp_mask_w<W> _pp_mask_or(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site)
+{
+  __pp_mask_w<W> resultMask;
+  resultMask.bits = maska.bits | maskb.bits;
+  PP_LOG("maskor", allBits<W>(), W, site, __pp_deps(NULL, &maska, &maskb));
+  return resultMask;
+}
 
-template <typename T>
-void _pp_hadd(__pp_vec<T> &vecResult, __pp_vec<T> &vec)
+template <int W>
+__pp_mask_w<W> _pp_mask_and(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH / 2; i++)
-  {
-    T result = vec.value[2 * i] + vec.value[2 * i + 1];
-    vecResult.value[2 * i] = result;
-    vecResult.value[2 * i + 1] = result;
-  }
-  PPLogger.addLog("hadd", _pp_init_ones(), VECTOR_WIDTH);
+  __pp_mask_w<W> resultMask;
+  resultMask.bits = maska.bits & maskb.bits;
+  PP_LOG("maskand", allBits<W>(), W, site, __pp_deps(NULL, &maska, &maskb));
+  return resultMask;
 }
 
-template void _pp_hadd<float>(__pp_vec_float &vecResult, __pp_vec_float &vec);
+template <int W>
+int _pp_cntbits(__pp_mask_w<W> &maska, __pp_site site)
+{
+  PP_LOG("cntbits", allBits<W>(), W, site, __pp_deps(NULL, &maska));
+  return __builtin_popcountll(maska.bits);
+}
 
-void _pp_hadd_float(__pp_vec_float &vecResult, __pp_vec_float &vec) { _pp_hadd<float>(vecResult, vec); }
+template <int W>
+void _pp_vset_float(__pp_vec<float, W> &vecResult, float value, __pp_mask_w<W> &mask, __pp_site site) { _pp_vset<float>(vecResult, value, mask, site); }
+template <int W>
+void _pp_vset_int(__pp_vec<int, W> &vecResult, int value, __pp_mask_w<W> &mask, __pp_site site) { _pp_vset<int>(vecResult, value, mask, site); }
 
-template <typename T>
-void _pp_interleave(__pp_vec<T> &vecResult, __pp_vec<T> vec)
+template <int W>
+__pp_vec<float, W> _pp_vset_float(float value, __pp_site site)
+{
+  __pp_vec<float, W> vecResult;
+  __pp_mask_w<W> mask = _pp_init_ones<W>();
+  _pp_vset_float(vecResult, value, mask, site);
+  return vecResult;
+}
+template <int W>
+__pp_vec<int, W> _pp_vset_int(int value, __pp_site site)
 {
-  for (int i = 0; i < VECTOR_WIDTH; i++)
+  __pp_vec<int, W> vecResult;
+  __pp_mask_w<W> mask = _pp_init_ones<W>();
+  _pp_vset_int(vecResult, value, mask, site);
+  return vecResult;
+}
+
+template <int W>
+void _pp_vmove_float(__pp_vec<float, W> &dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmove<float>(dest, src, mask, site); }
+template <int W>
+void _pp_vmove_int(__pp_vec<int, W> &dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmove<int>(dest, src, mask, site); }
+
+template <int W>
+void _pp_vload_float(__pp_vec<float, W> &dest, float *src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vload<float>(dest, src, mask, site); }
+template <int W>
+void _pp_vload_int(__pp_vec<int, W> &dest, int *src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vload<int>(dest, src, mask, site); }
+
+template <int W>
+void _pp_vstore_float(float *dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vstore<float>(dest, src, mask, site); }
+template <int W>
+void _pp_vstore_int(int *dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vstore<int>(dest, src, mask, site); }
+
+template <int W>
+void _pp_vadd_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vadd<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vadd_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vadd<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vsub_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vsub<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vsub_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vsub<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vmult_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmult<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vmult_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmult<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vdiv_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vdiv<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vdiv_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vdiv<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vabs_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_mask_w<W> &mask, __pp_site site) { _pp_vabs<float>(vecResult, veca, mask, site); }
+template <int W>
+void _pp_vabs_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_mask_w<W> &mask, __pp_site site) { _pp_vabs<int>(vecResult, veca, mask, site); }
+
+template <int W>
+void _pp_vgt_float(__pp_mask_w<W> &maskResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgt<float>(maskResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vgt_int(__pp_mask_w<W> &maskResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgt<int>(maskResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vlt_float(__pp_mask_w<W> &maskResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vlt<float>(maskResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vlt_int(__pp_mask_w<W> &maskResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vlt<int>(maskResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_veq_float(__pp_mask_w<W> &maskResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_veq<float>(maskResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_veq_int(__pp_mask_w<W> &maskResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_veq<int>(maskResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_hadd_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, __pp_site site) { _pp_hadd<float>(vecResult, vec, site); }
+
+template <int W>
+void _pp_interleave_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> vec, __pp_site site) { _pp_interleave<float>(vecResult, vec, site); }
+
+template <int W>
+float _pp_hreduce_add_float(__pp_vec<float, W> &vec, __pp_mask_w<W> &mask, __pp_site site) { return _pp_hreduce_add<float>(vec, mask, site); }
+template <int W>
+int _pp_hreduce_add_int(__pp_vec<int, W> &vec, __pp_mask_w<W> &mask, __pp_site site) { return _pp_hreduce_add<int>(vec, mask, site); }
+
+template <int W>
+void _pp_vpermute_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vpermute<float>(vecResult, vec, index, mask, site); }
+template <int W>
+void _pp_vpermute_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vpermute<int>(vecResult, vec, index, mask, site); }
+
+template <int W>
+void _pp_vbroadcast_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site) { _pp_vbroadcast<float>(vecResult, vec, lane, mask, site); }
+template <int W>
+void _pp_vbroadcast_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site) { _pp_vbroadcast<int>(vecResult, vec, lane, mask, site); }
+
+template <int W>
+void _pp_vfma_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_vec<float, W> &vecc, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
   {
-    int index = i < VECTOR_WIDTH / 2 ? (2 * i) : (2 * (i - VECTOR_WIDTH / 2) + 1);
-    vecResult.value[i] = vec.value[index];
+    vecResult.value[i] = lane(mask, i) ? fmaf(veca.value[i], vecb.value[i], vecc.value[i]) : vecResult.value[i];
   }
-  PPLogger.addLog("interleave", _pp_init_ones(), VECTOR_WIDTH);
+  PP_LOG("vfma", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &vecc, &mask));
 }
 
-template void _pp_interleave<float>(__pp_vec_float &vecResult, __pp_vec_float vec);
-
-void _pp_interleave_float(__pp_vec_float &vecResult, __pp_vec_float vec) { _pp_interleave<float>(vecResult, vec); }
-
-void addUserLog(const char *logStr)
+template <int W>
+void _pp_vmin_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmin<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vmin_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmin<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vmax_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmax<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+void _pp_vmax_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmax<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+void _pp_vselect_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site) { _pp_vselect<float>(vecResult, veca, vecb, sel, mask, site); }
+template <int W>
+void _pp_vselect_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site) { _pp_vselect<int>(vecResult, veca, vecb, sel, mask, site); }
+
+template <int W>
+void _pp_vgather_float(__pp_vec<float, W> &dest, float *base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgather<float>(dest, base, index, mask, site); }
+template <int W>
+void _pp_vgather_int(__pp_vec<int, W> &dest, int *base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgather<int>(dest, base, index, mask, site); }
+
+template <int W>
+void _pp_vscatter_float(float *base, __pp_vec<int, W> &index, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vscatter<float>(base, index, src, mask, site); }
+template <int W>
+void _pp_vscatter_int(int *base, __pp_vec<int, W> &index, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vscatter<int>(base, index, src, mask, site); }
+
+template <int W>
+int _pp_vcompress_float(float *dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vcompress<float>(dest, src, mask, site); }
+template <int W>
+int _pp_vcompress_int(int *dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vcompress<int>(dest, src, mask, site); }
+
+template <int W>
+int _pp_vexpand_float(__pp_vec<float, W> &dest, float *src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vexpand<float>(dest, src, mask, site); }
+template <int W>
+int _pp_vexpand_int(__pp_vec<int, W> &dest, int *src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vexpand<int>(dest, src, mask, site); }
+
+// Instantiate the mask functions for every width of every element type
+#define PP_INSTANTIATE_MASK(W)                                                                           \
+  template __pp_mask_w<W> _pp_init_ones<W>(int first);                                                   \
+  template __pp_mask_w<W> _pp_mask_not<W>(__pp_mask_w<W> &maska, __pp_site site);                        \
+  template __pp_mask_w<W> _pp_mask_or<W>(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site);  \
+  template __pp_mask_w<W> _pp_mask_and<W>(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site); \
+  template int _pp_cntbits<W>(__pp_mask_w<W> &maska, __pp_site site);
+
+PP_FOR_EACH_TYPED_WIDTH(PP_INSTANTIATE_MASK)
+
+#undef PP_INSTANTIATE_MASK
+
+// Instantiate the float and int functions for every supported width
+#define PP_INSTANTIATE(W)                                                                                                                               \
+  template void _pp_vset_float<W>(__pp_vec<float, W> &, float, __pp_mask_w<W> &, __pp_site);                                                            \
+  template void _pp_vset_int<W>(__pp_vec<int, W> &, int, __pp_mask_w<W> &, __pp_site);                                                                  \
+  template __pp_vec<float, W> _pp_vset_float<W>(float, __pp_site);                                                                                      \
+  template __pp_vec<int, W> _pp_vset_int<W>(int, __pp_site);                                                                                            \
+  template void _pp_vmove_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                                            \
+  template void _pp_vmove_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                                  \
+  template void _pp_vload_float<W>(__pp_vec<float, W> &, float *, __pp_mask_w<W> &, __pp_site);                                                         \
+  template void _pp_vload_int<W>(__pp_vec<int, W> &, int *, __pp_mask_w<W> &, __pp_site);                                                               \
+  template void _pp_vstore_float<W>(float *, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                                                        \
+  template void _pp_vstore_int<W>(int *, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                                              \
+  template void _pp_vadd_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                       \
+  template void _pp_vadd_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                               \
+  template void _pp_vsub_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                       \
+  template void _pp_vsub_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                               \
+  template void _pp_vmult_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                      \
+  template void _pp_vmult_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                              \
+  template void _pp_vdiv_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                       \
+  template void _pp_vdiv_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                               \
+  template void _pp_vabs_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                                             \
+  template void _pp_vabs_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                                   \
+  template void _pp_vgt_float<W>(__pp_mask_w<W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                            \
+  template void _pp_vgt_int<W>(__pp_mask_w<W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                  \
+  template void _pp_vlt_float<W>(__pp_mask_w<W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                            \
+  template void _pp_vlt_int<W>(__pp_mask_w<W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                  \
+  template void _pp_veq_float<W>(__pp_mask_w<W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                            \
+  template void _pp_veq_int<W>(__pp_mask_w<W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                  \
+  template void _pp_hadd_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_site);                                                               \
+  template void _pp_interleave_float<W>(__pp_vec<float, W> &, __pp_vec<float, W>, __pp_site);                                                           \
+  template float _pp_hreduce_add_float<W>(__pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                                                           \
+  template int _pp_hreduce_add_int<W>(__pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                                                 \
+  template void _pp_vpermute_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                     \
+  template void _pp_vpermute_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                           \
+  template void _pp_vbroadcast_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, int, __pp_mask_w<W> &, __pp_site);                                  \
+  template void _pp_vbroadcast_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, int, __pp_mask_w<W> &, __pp_site);                                        \
+  template void _pp_vfma_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site); \
+  template void _pp_vmin_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                       \
+  template void _pp_vmin_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                               \
+  template void _pp_vmax_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                       \
+  template void _pp_vmax_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                               \
+  template void _pp_vselect_float<W>(__pp_vec<float, W> &, __pp_vec<float, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_mask_w<W> &, __pp_site);  \
+  template void _pp_vselect_int<W>(__pp_vec<int, W> &, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_mask_w<W> &, __pp_site);          \
+  template void _pp_vgather_float<W>(__pp_vec<float, W> &, float *, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                   \
+  template void _pp_vgather_int<W>(__pp_vec<int, W> &, int *, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                         \
+  template void _pp_vscatter_float<W>(float *, __pp_vec<int, W> &, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                                  \
+  template void _pp_vscatter_int<W>(int *, __pp_vec<int, W> &, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                        \
+  template int _pp_vcompress_float<W>(float *, __pp_vec<float, W> &, __pp_mask_w<W> &, __pp_site);                                                      \
+  template int _pp_vcompress_int<W>(int *, __pp_vec<int, W> &, __pp_mask_w<W> &, __pp_site);                                                            \
+  template int _pp_vexpand_float<W>(__pp_vec<float, W> &, float *, __pp_mask_w<W> &, __pp_site);                                                        \
+  template int _pp_vexpand_int<W>(__pp_vec<int, W> &, int *, __pp_mask_w<W> &, __pp_site);
+
+PP_FOR_EACH_WIDTH(PP_INSTANTIATE)
+
+#undef PP_INSTANTIATE
+
+
+#endif
+
+// The double, int64, int16 and uint8 functions run on the lane-by-lane
+// bodies with either backend
+#define PP_DEFINE_TYPE(NAME, T, ACC)                                                                                                                                                                    \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vset_##NAME(__pp_vec<T, W> &vecResult, T value, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vset<T>(vecResult, value, mask, site); }                                           \
+  template <int W>                                                                                                                                                                                      \
+  __pp_vec<T, W> _pp_vset_##NAME(T value, __pp_site site)                                                                                                                                               \
+  {                                                                                                                                                                                                     \
+    __pp_vec<T, W> vecResult;                                                                                                                                                                           \
+    __pp_mask_w<W> mask = _pp_init_ones<W>();                                                                                                                                                           \
+    __pp_generic::_pp_vset<T>(vecResult, value, mask, site);                                                                                                                                            \
+    return vecResult;                                                                                                                                                                                   \
+  }                                                                                                                                                                                                     \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vmove_##NAME(__pp_vec<T, W> &dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vmove<T>(dest, src, mask, site); }                                         \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vload_##NAME(__pp_vec<T, W> &dest, T *src, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vload<T>(dest, src, mask, site); }                                                      \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vstore_##NAME(T *dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vstore<T>(dest, src, mask, site); }                                                    \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vadd_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vadd<T>(vecResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vsub_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vsub<T>(vecResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vmult_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vmult<T>(vecResult, veca, vecb, mask, site); } \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vdiv_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vdiv<T>(vecResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vabs_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vabs<T>(vecResult, veca, mask, site); }                               \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vmin_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vmin<T>(vecResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vmax_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vmax<T>(vecResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vgt_##NAME(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vgt<T>(maskResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_vlt_##NAME(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_vlt<T>(maskResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  void _pp_veq_##NAME(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { __pp_generic::_pp_veq<T>(maskResult, veca, vecb, mask, site); }   \
+  template <int W>                                                                                                                                                                                      \
+  ACC _pp_hreduce_add_##NAME(__pp_vec<T, W> &vec, __pp_mask_w<W> &mask, __pp_site site) { return __pp_generic::_pp_hreduce_add<T, ACC>(vec, mask, site); }
+
+PP_DEFINE_TYPE(double, double, double)
+PP_DEFINE_TYPE(int64, long long, long long)
+PP_DEFINE_TYPE(int16, short, int)
+PP_DEFINE_TYPE(uint8, unsigned char, int)
+
+#undef PP_DEFINE_TYPE
+
+// Instantiate them for every width at the lane count of each type
+#define PP_INSTANTIATE_TYPE(W, NAME, T, ACC)                                                                            \
+  template void _pp_vset_##NAME<W>(__pp_vec<T, W> &, T, __pp_mask_w<W> &, __pp_site);                                   \
+  template __pp_vec<T, W> _pp_vset_##NAME<W>(T, __pp_site);                                                             \
+  template void _pp_vmove_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);                   \
+  template void _pp_vload_##NAME<W>(__pp_vec<T, W> &, T *, __pp_mask_w<W> &, __pp_site);                                \
+  template void _pp_vstore_##NAME<W>(T *, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);                               \
+  template void _pp_vadd_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);  \
+  template void _pp_vsub_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);  \
+  template void _pp_vmult_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site); \
+  template void _pp_vdiv_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);  \
+  template void _pp_vabs_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);                    \
+  template void _pp_vmin_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);  \
+  template void _pp_vmax_##NAME<W>(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);  \
+  template void _pp_vgt_##NAME<W>(__pp_mask_w<W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);   \
+  template void _pp_vlt_##NAME<W>(__pp_mask_w<W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);   \
+  template void _pp_veq_##NAME<W>(__pp_mask_w<W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);   \
+  template ACC _pp_hreduce_add_##NAME<W>(__pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+
+#define PP_INSTANTIATE_TYPES(W)                       \
+  PP_INSTANTIATE_TYPE(W, double, double, double)      \
+  PP_INSTANTIATE_TYPE(W, int64, long long, long long) \
+  PP_INSTANTIATE_TYPE(W, int16, short, int)           \
+  PP_INSTANTIATE_TYPE(W, uint8, unsigned char, int)
+
+PP_FOR_EACH_TYPED_WIDTH(PP_INSTANTIATE_TYPES)
+
+#undef PP_INSTANTIATE_TYPES
+#undef PP_INSTANTIATE_TYPE
+
+void addUserLog(const char *logStr, __pp_site site)
 {
-  PPLogger.addLog(logStr, _pp_init_ones(), 0);
+  PPLogger.addLog(logStr, 0ULL, 0, site);
 }
@@ -11,13 +11,57 @@
 
 extern Logger PPLogger;
 
-template <typename T>
-struct __pp_vec {
-  T value[VECTOR_WIDTH];
+// NOLOG=1 builds (-DPP_NOLOG, native backend only) skip the Logger in every
+// intrinsic. Updating the counters alone serializes the kernels on memory,
+// so this is what makes them run at native speed on large N, at the price of
+// collecting no statistics, log, profile or cycle estimate.
+#ifdef PP_NOLOG
+#ifndef PP_NATIVE
+#error "PP_NOLOG needs PP_NATIVE"
+#endif
+#define PP_LOG(...) ((void)0)
+#else
+#define PP_LOG(...) PPLogger.addLog(__VA_ARGS__)
+#endif
+
+// Every type and function below takes the vector width W as a template
+// parameter that defaults to VECTOR_WIDTH, so kernels written for the default
+// width compile unchanged and template kernels can run at any width.
+
+// The native backend processes registers in chunks of PP_NATIVE_LANES floats
+// (8 with AVX2, 4 with SSE) and pads vectors up to a multiple of 4 lanes
+#ifdef PP_NATIVE
+#if defined(__AVX2__)
+#define PP_NATIVE_LANES 8
+#elif defined(__SSE4_1__)
+#define PP_NATIVE_LANES 4
+#else
+#error "PP_NATIVE needs -msse4.1 or -mavx2"
+#endif
+#define PP_VEC_ALIGN (PP_NATIVE_LANES * 4)
+#define PP_VEC_STORAGE(W) (((W) + 3) / 4 * 4)
+#else
+#define PP_VEC_ALIGN alignof(T)
+#define PP_VEC_STORAGE(W) (W)
+#endif
+
+// Registers start out zeroed like masks: a masked native op blends the whole
+// register, so its inactive lanes must hold a defined value
+template <typename T, int W = VECTOR_WIDTH>
+struct alignas(PP_VEC_ALIGN) __pp_vec {
+  T value[PP_VEC_STORAGE(W)] = {};
+};
+
+// Declare a mask of W lanes with __pp_mask_w<W>. Lane i is bit i of bits and
+// the bits above W are always 0 (masks start out empty), so mask operations
+// are single word operations.
+template <int W>
+struct __pp_mask_w {
+  unsigned long long bits = 0;
 };
 
 // Declare a mask with __pp_mask
-struct __pp_mask : __pp_vec<bool> {};
+typedef __pp_mask_w<VECTOR_WIDTH> __pp_mask;
 
 // Declare a floating point vector register with __pp_vec_float
 #define __pp_vec_float __pp_vec<float>
@@ -25,99 +69,344 @@ struct __pp_mask : __pp_vec<bool> {};
 // Declare an integer vector register with __pp_vec_int
 #define __pp_vec_int   __pp_vec<int>
 
+// A register of W lanes is W * 4 bytes wide. It holds PP_LANES(B, W) lanes of
+// B-byte elements: half as many doubles, twice as many int16 and four times
+// as many uint8 (at least 1 and at most 64).
+#define PP_LANES(B, W) ((W) * 4 / (B) < 1 ? 1 : (W) * 4 / (B) > 64 ? 64 : (W) * 4 / (B))
+
+template <typename T, int W = VECTOR_WIDTH>
+constexpr int __pp_lanes_of = PP_LANES((int)sizeof(T), W);
+
+// Declare a double, int64, int16 or uint8 vector register, and a mask with
+// one bit per lane of it
+typedef __pp_vec<double, __pp_lanes_of<double>> __pp_vec_double;
+typedef __pp_vec<long long, __pp_lanes_of<long long>> __pp_vec_int64;
+typedef __pp_vec<short, __pp_lanes_of<short>> __pp_vec_int16;
+typedef __pp_vec<unsigned char, __pp_lanes_of<unsigned char>> __pp_vec_uint8;
+typedef __pp_mask_w<__pp_lanes_of<double>> __pp_mask_double;
+typedef __pp_mask_w<__pp_lanes_of<long long>> __pp_mask_int64;
+typedef __pp_mask_w<__pp_lanes_of<short>> __pp_mask_int16;
+typedef __pp_mask_w<__pp_lanes_of<unsigned char>> __pp_mask_uint8;
+
+// Expands X(W) for every width the functions below are instantiated for
+#if (VECTOR_WIDTH & (VECTOR_WIDTH - 1)) == 0
+#define PP_FOR_EACH_WIDTH(X) X(1) X(2) X(4) X(8) X(16) X(32) X(64)
+#else
+#define PP_FOR_EACH_WIDTH(X) X(1) X(2) X(4) X(8) X(16) X(32) X(64) X(VECTOR_WIDTH)
+#endif
+
+// The double, int64, int16 and uint8 functions (and the mask functions) are
+// also instantiated for the lane counts of those types at VECTOR_WIDTH that
+// are not a power of two
+#define PP_LANES_IS_POW2(B) ((PP_LANES(B, VECTOR_WIDTH) & (PP_LANES(B, VECTOR_WIDTH) - 1)) == 0)
+#if PP_LANES_IS_POW2(8)
+#define PP_EXTRA_WIDTH_8(X)
+#else
+#define PP_EXTRA_WIDTH_8(X) X(PP_LANES(8, VECTOR_WIDTH))
+#endif
+#if PP_LANES_IS_POW2(2)
+#define PP_EXTRA_WIDTH_2(X)
+#else
+#define PP_EXTRA_WIDTH_2(X) X(PP_LANES(2, VECTOR_WIDTH))
+#endif
+#if PP_LANES_IS_POW2(1)
+#define PP_EXTRA_WIDTH_1(X)
+#else
+#define PP_EXTRA_WIDTH_1(X) X(PP_LANES(1, VECTOR_WIDTH))
+#endif
+#define PP_FOR_EACH_TYPED_WIDTH(X) PP_FOR_EACH_WIDTH(X) PP_EXTRA_WIDTH_8(X) PP_EXTRA_WIDTH_2(X) PP_EXTRA_WIDTH_1(X)
+
 //***********************
 //* Function Definition *
 //***********************
 
 // Return a mask initialized to 1 in the first N lanes and 0 in the others
-__pp_mask _pp_init_ones(int first = VECTOR_WIDTH);
+template <int W = VECTOR_WIDTH>
+__pp_mask_w<W> _pp_init_ones(int first = W);
 
 // Return the inverse of maska
-__pp_mask _pp_mask_not(__pp_mask &maska);
+template <int W>
+__pp_mask_w<W> _pp_mask_not(__pp_mask_w<W> &maska, __pp_site site = __pp_site());
 
 // Return (maska | maskb)
-__pp_mask _pp_mask_or(__pp_mask &maska, __pp_mask &maskb);
+template <int W>
+__pp_mask_w<W> _pp_mask_or(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site = __pp_site());
 
 // Return (maska & maskb)
-__pp_mask _pp_mask_and(__pp_mask &maska, __pp_mask &maskb);
+template <int W>
+__pp_mask_w<W> _pp_mask_and(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site = __pp_site());
 
 // Count the number of 1s in maska
-int _pp_cntbits(__pp_mask &maska);
+template <int W>
+int _pp_cntbits(__pp_mask_w<W> &maska, __pp_site site = __pp_site());
 
 // Set register to value if vector lane is active
 //  otherwise keep the old value
-void _pp_vset_float(__pp_vec_float &vecResult, float value, __pp_mask &mask);
-void _pp_vset_int(__pp_vec_int &vecResult, int value, __pp_mask &mask);
+template <int W>
+void _pp_vset_float(__pp_vec<float, W> &vecResult, float value, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vset_int(__pp_vec<int, W> &vecResult, int value, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 // For user's convenience, returns a vector register with all lanes initialized to value
-__pp_vec_float _pp_vset_float(float value);
-__pp_vec_int _pp_vset_int(int value);
+template <int W = VECTOR_WIDTH>
+__pp_vec<float, W> _pp_vset_float(float value, __pp_site site = __pp_site());
+template <int W = VECTOR_WIDTH>
+__pp_vec<int, W> _pp_vset_int(int value, __pp_site site = __pp_site());
 
 // Copy values from vector register src to vector register dest if vector lane active
 // otherwise keep the old value
-void _pp_vmove_float(__pp_vec_float &dest, __pp_vec_float &src, __pp_mask &mask);
-void _pp_vmove_int(__pp_vec_int &dest, __pp_vec_int &src, __pp_mask &mask);
+template <int W>
+void _pp_vmove_float(__pp_vec<float, W> &dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vmove_int(__pp_vec<int, W> &dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Load values from array src to vector register dest if vector lane active
 //  otherwise keep the old value
-void _pp_vload_float(__pp_vec_float &dest, float* src, __pp_mask &mask);
-void _pp_vload_int(__pp_vec_int &dest, int* src, __pp_mask &mask);
+template <int W>
+void _pp_vload_float(__pp_vec<float, W> &dest, float* src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vload_int(__pp_vec<int, W> &dest, int* src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Store values from vector register src to array dest if vector lane active
 //  otherwise keep the old value
-void _pp_vstore_float(float* dest, __pp_vec_float &src, __pp_mask &mask);
-void _pp_vstore_int(int* dest, __pp_vec_int &src, __pp_mask &mask);
+template <int W>
+void _pp_vstore_float(float* dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vstore_int(int* dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return calculation of (veca + vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_vadd_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_vadd_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_vadd_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vadd_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return calculation of (veca - vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_vsub_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_vsub_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_vsub_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vsub_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return calculation of (veca * vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_vmult_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_vmult_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_vmult_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vmult_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return calculation of (veca / vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_vdiv_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_vdiv_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_vdiv_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vdiv_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 
 // Return calculation of absolute value abs(veca) if vector lane active
 //  otherwise keep the old value
-void _pp_vabs_float(__pp_vec_float &vecResult, __pp_vec_float &veca, __pp_mask &mask);
-void _pp_vabs_int(__pp_vec_int &vecResult, __pp_vec_int &veca, __pp_mask &mask);
+template <int W>
+void _pp_vabs_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vabs_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return a mask of (veca > vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_vgt_float(__pp_mask &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_vgt_int(__pp_mask &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_vgt_float(__pp_mask_w<W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vgt_int(__pp_mask_w<W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return a mask of (veca < vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_vlt_float(__pp_mask &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_vlt_int(__pp_mask &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_vlt_float(__pp_mask_w<W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vlt_int(__pp_mask_w<W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Return a mask of (veca == vecb) if vector lane active
 //  otherwise keep the old value
-void _pp_veq_float(__pp_mask &vecResult, __pp_vec_float &veca, __pp_vec_float &vecb, __pp_mask &mask);
-void _pp_veq_int(__pp_mask &vecResult, __pp_vec_int &veca, __pp_vec_int &vecb, __pp_mask &mask);
+template <int W>
+void _pp_veq_float(__pp_mask_w<W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_veq_int(__pp_mask_w<W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
 
 // Adds up adjacent pairs of elements, so
 //  [0 1 2 3] -> [0+1 0+1 2+3 2+3]
-void _pp_hadd_float(__pp_vec_float &vecResult, __pp_vec_float &vec);
+template <int W>
+void _pp_hadd_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, __pp_site site = __pp_site());
 
 // Performs an even-odd interleaving where all even-indexed elements move to front half
 //  of the array and odd-indexed to the back half, so
 //  [0 1 2 3 4 5 6 7] -> [0 2 4 6 1 3 5 7]
-void _pp_interleave_float(__pp_vec_float &vecResult, __pp_vec_float vec);
+template <int W>
+void _pp_interleave_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> vec, __pp_site site = __pp_site());
+
+// Return the sum of the active lanes of vec
+template <int W>
+float _pp_hreduce_add_float(__pp_vec<float, W> &vec, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+int _pp_hreduce_add_int(__pp_vec<int, W> &vec, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Set vecResult[i] = vec[index[i]] if vector lane is active, indices must be in [0, W)
+//  otherwise keep the old value
+template <int W>
+void _pp_vpermute_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vpermute_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Set vecResult[i] = vec[lane] if vector lane is active
+//  otherwise keep the old value
+template <int W>
+void _pp_vbroadcast_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vbroadcast_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Return calculation of (veca * vecb + vecc) if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _pp_vfma_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_vec<float, W> &vecc, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Return min(veca, vecb) / max(veca, vecb) if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _pp_vmin_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vmin_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vmax_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vmax_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Return (sel ? veca : vecb) if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _pp_vselect_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vselect_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Load dest[i] = base[index[i]] if vector lane active
+//  otherwise keep the old value
+template <int W>
+void _pp_vgather_float(__pp_vec<float, W> &dest, float* base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vgather_int(__pp_vec<int, W> &dest, int* base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Store base[index[i]] = src[i] if vector lane active, in lane order when
+//  indices repeat
+template <int W>
+void _pp_vscatter_float(float* base, __pp_vec<int, W> &index, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+void _pp_vscatter_int(int* base, __pp_vec<int, W> &index, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Store the active lanes of src to consecutive elements of dest and return
+//  how many were stored
+template <int W>
+int _pp_vcompress_float(float* dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+int _pp_vcompress_int(int* dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Load consecutive elements of src into the active lanes of dest and return
+//  how many were loaded, inactive lanes keep the old value
+template <int W>
+int _pp_vexpand_float(__pp_vec<float, W> &dest, float* src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+template <int W>
+int _pp_vexpand_int(__pp_vec<int, W> &dest, int* src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+// Declares vset, vmove, vload, vstore, vadd, vsub, vmult, vdiv, vabs, vmin,
+// vmax, vgt, vlt, veq and hreduce_add for element type T with suffix NAME.
+// They behave like the float versions above; integer arithmetic wraps around
+// and hreduce_add returns the sum as an ACC.
+#define PP_DECLARE_TYPE(NAME, T, ACC)                                                                                                               \
+  template <int W>                                                                                                                                  \
+  void _pp_vset_##NAME(__pp_vec<T, W> &vecResult, T value, __pp_mask_w<W> &mask, __pp_site site = __pp_site());                                     \
+  template <int W = __pp_lanes_of<T>>                                                                                                               \
+  __pp_vec<T, W> _pp_vset_##NAME(T value, __pp_site site = __pp_site());                                                                            \
+  template <int W>                                                                                                                                  \
+  void _pp_vmove_##NAME(__pp_vec<T, W> &dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());                             \
+  template <int W>                                                                                                                                  \
+  void _pp_vload_##NAME(__pp_vec<T, W> &dest, T *src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());                                          \
+  template <int W>                                                                                                                                  \
+  void _pp_vstore_##NAME(T *dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site = __pp_site());                                         \
+  template <int W>                                                                                                                                  \
+  void _pp_vadd_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_vsub_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_vmult_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site()); \
+  template <int W>                                                                                                                                  \
+  void _pp_vdiv_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_vabs_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_mask_w<W> &mask, __pp_site site = __pp_site());                        \
+  template <int W>                                                                                                                                  \
+  void _pp_vmin_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_vmax_##NAME(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_vgt_##NAME(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_vlt_##NAME(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  void _pp_veq_##NAME(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site = __pp_site());  \
+  template <int W>                                                                                                                                  \
+  ACC _pp_hreduce_add_##NAME(__pp_vec<T, W> &vec, __pp_mask_w<W> &mask, __pp_site site = __pp_site());
+
+PP_DECLARE_TYPE(double, double, double)
+PP_DECLARE_TYPE(int64, long long, long long)
+PP_DECLARE_TYPE(int16, short, int)
+PP_DECLARE_TYPE(uint8, unsigned char, int)
+
+#undef PP_DECLARE_TYPE
 
 // Add a customized log to help debugging
-void addUserLog(const char * logStr);
+void addUserLog(const char * logStr, __pp_site site = __pp_site());
+
+// Compile with -DPP_NATIVE to run the functions above on real SSE/AVX2 registers
+#ifdef PP_NATIVE
+#include "PPintrin_native.h"
+#endif
+
+//****************
+//* Loop Drivers *
+//****************
+
+// Call body(i, mask) for every group of W elements of [0, N): full groups get
+// all lanes, a last partial group gets the first N % W lanes. Loads and stores
+// under mask never touch elements past N.
+template <int W = VECTOR_WIDTH, typename Body>
+inline void pp_for_each_vector(int N, Body body)
+{
+  __pp_mask_w<W> maskAll = _pp_init_ones<W>();
+  int i = 0;
+  for (; i + W <= N; i += W)
+    body(i, maskAll);
+  if (i < N)
+  {
+    __pp_mask_w<W> maskTail = _pp_init_ones<W>(N - i);
+    body(i, maskTail);
+  }
+}
+
+// Same as pp_for_each_vector, unrolled by K: body(i, k, mask) gets the
+// unroll slot k in [0, K) so it can keep K independent accumulators. Groups
+// left over after the unrolled blocks (and the tail) take slots 0, 1, ...
+template <int K, int W = VECTOR_WIDTH, typename Body>
+inline void pp_for_each_vector_unroll(int N, Body body)
+{
+  __pp_mask_w<W> maskAll = _pp_init_ones<W>();
+  int i = 0;
+  for (; i + K * W <= N; i += K * W)
+  {
+    for (int k = 0; k < K; k++)
+      body(i + k * W, k, maskAll);
+  }
+  int k = 0;
+  for (; i + W <= N; i += W)
+    body(i, k++, maskAll);
+  if (i < N)
+  {
+    __pp_mask_w<W> maskTail = _pp_init_ones<W>(N - i);
+    body(i, k, maskTail);
+  }
+}
 
 #endif
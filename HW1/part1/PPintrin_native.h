@@ -0,0 +1,721 @@
+#ifndef PPINTRIN_NATIVE_H_
+#define PPINTRIN_NATIVE_H_
+
+// Native backend for PPintrin.h: every __pp_vec is processed in chunks of
+// real SSE (4 lanes) or AVX2 (8 lanes) registers and the masks become lane
+// masks for blend/maskload/maskstore. The functions are inline so that the
+// kernels in vectorOP.cpp compile down to plain intrinsic sequences; the
+// Logger only receives the active-lane bits of each instruction.
+//
+// A width that is a multiple of 8 uses AVX2 registers when available, any
+// other width uses SSE registers. Vectors are padded to a multiple of 4 lanes
+// and the padding lanes are never active, since mask bits above W are 0.
+// Masked loads and stores never touch memory under inactive or padding lanes:
+// AVX2 has maskload/maskstore, SSE goes lane by lane for partial masks.
+
+#include <immintrin.h>
+#include <string.h>
+
+//*******************
+//* Register Traits *
+//*******************
+
+// Lanes per native register for a vector of W lanes
+template <int W>
+struct __pp_lanes
+{
+  static constexpr int value = (PP_NATIVE_LANES == 8 && W % 8 == 0) ? 8 : 4;
+};
+
+// Register masks of L 32-bit lanes, all-ones for active lanes
+template <int L>
+struct __pp_nmask;
+
+template <typename T, int L>
+struct __pp_native;
+
+// Fused multiply-add when the target has it (-mfma or -march=native),
+// otherwise a multiply and an add with one more rounding step
+#ifdef __FMA__
+inline __m128 __pp_fmadd_ps(__m128 a, __m128 b, __m128 c) { return _mm_fmadd_ps(a, b, c); }
+#else
+inline __m128 __pp_fmadd_ps(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+#if PP_NATIVE_LANES == 8
+#ifdef __FMA__
+inline __m256 __pp_fmadd_ps(__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline __m256 __pp_fmadd_ps(__m256 a, __m256 b, __m256 c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+#endif
+
+template <>
+struct __pp_nmask<4>
+{
+  typedef __m128i type;
+
+  // Expand the low 4 mask bits into 4 all-ones / all-zeros 32-bit lanes
+  static type load(unsigned long long bits)
+  {
+    __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+    return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), lanes), lanes);
+  }
+  static unsigned long long bits(type m) { return (unsigned long long)_mm_movemask_ps(_mm_castsi128_ps(m)); }
+};
+
+// SSE has no masked load/store: a full mask uses one unaligned access, a
+// partial one copies just its active lanes
+template <typename T>
+inline void __pp_copy_lanes(T *dest, const T *src, int bits)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    if ((bits >> i) & 1)
+      dest[i] = src[i];
+  }
+}
+
+template <>
+struct __pp_native<float, 4>
+{
+  typedef __m128 reg;
+  typedef __m128i mask;
+  static reg load(const float *p) { return _mm_load_ps(p); }
+  static void store(float *p, reg v) { _mm_store_ps(p, v); }
+  static reg set1(float x) { return _mm_set1_ps(x); }
+  static reg blend(reg old, reg v, mask m) { return _mm_blendv_ps(old, v, _mm_castsi128_ps(m)); }
+  static reg maskload(const float *p, mask m)
+  {
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+    if (bits == 0xF)
+      return _mm_loadu_ps(p);
+    alignas(16) float lanes[4] = {0, 0, 0, 0};
+    __pp_copy_lanes(lanes, p, bits);
+    return _mm_load_ps(lanes);
+  }
+  static void maskstore(float *p, reg v, mask m)
+  {
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+    if (bits == 0xF)
+    {
+      _mm_storeu_ps(p, v);
+      return;
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, v);
+    __pp_copy_lanes(p, lanes, bits);
+  }
+  static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+  static reg abs(reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+  static reg fma(reg a, reg b, reg c) { return __pp_fmadd_ps(a, b, c); }
+  // Same lane choice as (a < b ? a : b) and (a > b ? a : b)
+  static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+  static float hsum(reg a)
+  {
+    __m128 shuf = _mm_movehdup_ps(a);
+    __m128 sums = _mm_add_ps(a, shuf);
+    return _mm_cvtss_f32(_mm_add_ss(sums, _mm_movehl_ps(shuf, sums)));
+  }
+  // Swap the lanes of each adjacent pair
+  static reg pairswap(reg a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+  static mask gt(reg a, reg b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+  static mask lt(reg a, reg b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+  static mask eq(reg a, reg b) { return _mm_castps_si128(_mm_cmpeq_ps(a, b)); }
+};
+
+template <>
+struct __pp_native<int, 4>
+{
+  typedef __m128i reg;
+  typedef __m128i mask;
+  static reg load(const int *p) { return _mm_load_si128((const __m128i *)p); }
+  static void store(int *p, reg v) { _mm_store_si128((__m128i *)p, v); }
+  static reg set1(int x) { return _mm_set1_epi32(x); }
+  static reg blend(reg old, reg v, mask m) { return _mm_blendv_epi8(old, v, m); }
+  static reg maskload(const int *p, mask m)
+  {
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+    if (bits == 0xF)
+      return _mm_loadu_si128((const __m128i *)p);
+    alignas(16) int lanes[4] = {0, 0, 0, 0};
+    __pp_copy_lanes(lanes, p, bits);
+    return _mm_load_si128((const __m128i *)lanes);
+  }
+  static void maskstore(int *p, reg v, mask m)
+  {
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+    if (bits == 0xF)
+    {
+      _mm_storeu_si128((__m128i *)p, v);
+      return;
+    }
+    alignas(16) int lanes[4];
+    _mm_store_si128((__m128i *)lanes, v);
+    __pp_copy_lanes(p, lanes, bits);
+  }
+  static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+  static reg sub(reg a, reg b) { return _mm_sub_epi32(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mullo_epi32(a, b); }
+  static reg abs(reg a) { return _mm_abs_epi32(a); }
+  static reg min(reg a, reg b) { return _mm_min_epi32(a, b); }
+  static reg max(reg a, reg b) { return _mm_max_epi32(a, b); }
+  static int hsum(reg a)
+  {
+    a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2)));
+    a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(a);
+  }
+  static mask gt(reg a, reg b) { return _mm_cmpgt_epi32(a, b); }
+  static mask lt(reg a, reg b) { return _mm_cmplt_epi32(a, b); }
+  static mask eq(reg a, reg b) { return _mm_cmpeq_epi32(a, b); }
+};
+
+#if PP_NATIVE_LANES == 8
+
+template <>
+struct __pp_nmask<8>
+{
+  typedef __m256i type;
+
+  // Expand the low 8 mask bits into 8 all-ones / all-zeros 32-bit lanes
+  static type load(unsigned long long bits)
+  {
+    __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), lanes), lanes);
+  }
+  static unsigned long long bits(type m) { return (unsigned long long)_mm256_movemask_ps(_mm256_castsi256_ps(m)); }
+};
+
+template <>
+struct __pp_native<float, 8>
+{
+  typedef __m256 reg;
+  typedef __m256i mask;
+  static reg load(const float *p) { return _mm256_load_ps(p); }
+  static void store(float *p, reg v) { _mm256_store_ps(p, v); }
+  static reg set1(float x) { return _mm256_set1_ps(x); }
+  static reg blend(reg old, reg v, mask m) { return _mm256_blendv_ps(old, v, _mm256_castsi256_ps(m)); }
+  static reg maskload(const float *p, mask m) { return _mm256_maskload_ps(p, m); }
+  static void maskstore(float *p, reg v, mask m) { _mm256_maskstore_ps(p, m, v); }
+  static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+  static reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+  static reg fma(reg a, reg b, reg c) { return __pp_fmadd_ps(a, b, c); }
+  static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+  static float hsum(reg a) { return __pp_native<float, 4>::hsum(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1))); }
+  // Swap the lanes of each adjacent pair
+  static reg pairswap(reg a) { return _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)); }
+  static mask gt(reg a, reg b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+  static mask lt(reg a, reg b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+  static mask eq(reg a, reg b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+};
+
+template <>
+struct __pp_native<int, 8>
+{
+  typedef __m256i reg;
+  typedef __m256i mask;
+  static reg load(const int *p) { return _mm256_load_si256((const __m256i *)p); }
+  static void store(int *p, reg v) { _mm256_store_si256((__m256i *)p, v); }
+  static reg set1(int x) { return _mm256_set1_epi32(x); }
+  static reg blend(reg old, reg v, mask m) { return _mm256_blendv_epi8(old, v, m); }
+  static reg maskload(const int *p, mask m) { return _mm256_maskload_epi32(p, m); }
+  static void maskstore(int *p, reg v, mask m) { _mm256_maskstore_epi32(p, m, v); }
+  static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  static reg sub(reg a, reg b) { return _mm256_sub_epi32(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mullo_epi32(a, b); }
+  static reg abs(reg a) { return _mm256_abs_epi32(a); }
+  static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+  static int hsum(reg a) { return __pp_native<int, 4>::hsum(_mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1))); }
+  static mask gt(reg a, reg b) { return _mm256_cmpgt_epi32(a, b); }
+  static mask lt(reg a, reg b) { return _mm256_cmpgt_epi32(b, a); }
+  static mask eq(reg a, reg b) { return _mm256_cmpeq_epi32(a, b); }
+};
+
+#endif
+
+// Run f(lane offset, register mask) once per native register of a W-lane
+// __pp_vec
+template <int W, typename F>
+inline void __pp_native_chunks(const __pp_mask_w<W> &mask, F f)
+{
+  typedef __pp_nmask<__pp_lanes<W>::value> M;
+  for (int c = 0; c < W; c += __pp_lanes<W>::value)
+  {
+    f(c, M::load(mask.bits >> c));
+  }
+}
+
+template <int W>
+inline unsigned long long __pp_native_all()
+{
+  return ~0ULL >> (64 - W);
+}
+
+//******************
+//* Implementation *
+//******************
+
+template <int W>
+inline __pp_mask_w<W> _pp_init_ones(int first)
+{
+  __pp_mask_w<W> mask;
+  mask.bits = first >= W ? __pp_native_all<W>() : first > 0 ? (1ULL << first) - 1 : 0;
+  return mask;
+}
+
+// The result is returned by value, so no destination is recorded (see
+// machine_model.h)
+template <int W>
+inline __pp_mask_w<W> _pp_mask_not(__pp_mask_w<W> &maska, __pp_site site)
+{
+  __pp_mask_w<W> resultMask;
+  resultMask.bits = ~maska.bits & __pp_native_all<W>();
+  PP_LOG("masknot", __pp_native_all<W>(), W, site, __pp_deps(NULL, &maska));
+  return resultMask;
+}
+
+template <int W>
+inline __pp_mask_w<W> _pp_mask_or(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site)
+{
+  __pp_mask_w<W> resultMask;
+  resultMask.bits = maska.bits | maskb.bits;
+  PP_LOG("maskor", __pp_native_all<W>(), W, site, __pp_deps(NULL, &maska, &maskb));
+  return resultMask;
+}
+
+template <int W>
+inline __pp_mask_w<W> _pp_mask_and(__pp_mask_w<W> &maska, __pp_mask_w<W> &maskb, __pp_site site)
+{
+  __pp_mask_w<W> resultMask;
+  resultMask.bits = maska.bits & maskb.bits;
+  PP_LOG("maskand", __pp_native_all<W>(), W, site, __pp_deps(NULL, &maska, &maskb));
+  return resultMask;
+}
+
+template <int W>
+inline int _pp_cntbits(__pp_mask_w<W> &maska, __pp_site site)
+{
+  PP_LOG("cntbits", __pp_native_all<W>(), W, site, __pp_deps(NULL, &maska));
+  return __builtin_popcountll(maska.bits);
+}
+
+template <typename T, int W>
+inline void _pp_vset(__pp_vec<T, W> &vecResult, T value, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  typename R::reg v = R::set1(value);
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), v, m));
+  });
+  PP_LOG("vset", mask.bits, W, site, __pp_deps(&vecResult, &mask));
+}
+
+template <int W>
+inline void _pp_vset_float(__pp_vec<float, W> &vecResult, float value, __pp_mask_w<W> &mask, __pp_site site) { _pp_vset<float>(vecResult, value, mask, site); }
+template <int W>
+inline void _pp_vset_int(__pp_vec<int, W> &vecResult, int value, __pp_mask_w<W> &mask, __pp_site site) { _pp_vset<int>(vecResult, value, mask, site); }
+
+template <int W>
+inline __pp_vec<float, W> _pp_vset_float(float value, __pp_site site)
+{
+  __pp_vec<float, W> vecResult = __pp_vec<float, W>(); // every lane is set, but blend reads the old ones
+  __pp_mask_w<W> mask = _pp_init_ones<W>();
+  _pp_vset_float(vecResult, value, mask, site);
+  return vecResult;
+}
+template <int W>
+inline __pp_vec<int, W> _pp_vset_int(int value, __pp_site site)
+{
+  __pp_vec<int, W> vecResult = __pp_vec<int, W>(); // every lane is set, but blend reads the old ones
+  __pp_mask_w<W> mask = _pp_init_ones<W>();
+  _pp_vset_int(vecResult, value, mask, site);
+  return vecResult;
+}
+
+template <typename T, int W>
+inline void _pp_vmove(__pp_vec<T, W> &dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    R::store(dest.value + c, R::blend(R::load(dest.value + c), R::load(src.value + c), m));
+  });
+  PP_LOG("vmove", mask.bits, W, site, __pp_deps(&dest, &src, &mask));
+}
+
+template <int W>
+inline void _pp_vmove_float(__pp_vec<float, W> &dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmove<float>(dest, src, mask, site); }
+template <int W>
+inline void _pp_vmove_int(__pp_vec<int, W> &dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmove<int>(dest, src, mask, site); }
+
+template <typename T, int W>
+inline void _pp_vload(__pp_vec<T, W> &dest, T *src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    R::store(dest.value + c, R::blend(R::load(dest.value + c), R::maskload(src + c, m), m));
+  });
+  PP_LOG("vload", mask.bits, W, site, __pp_deps(&dest, &mask));
+}
+
+template <int W>
+inline void _pp_vload_float(__pp_vec<float, W> &dest, float *src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vload<float>(dest, src, mask, site); }
+template <int W>
+inline void _pp_vload_int(__pp_vec<int, W> &dest, int *src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vload<int>(dest, src, mask, site); }
+
+template <typename T, int W>
+inline void _pp_vstore(T *dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    R::maskstore(dest + c, R::load(src.value + c), m);
+  });
+  PP_LOG("vstore", mask.bits, W, site, __pp_deps(NULL, &src, &mask));
+}
+
+template <int W>
+inline void _pp_vstore_float(float *dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vstore<float>(dest, src, mask, site); }
+template <int W>
+inline void _pp_vstore_int(int *dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vstore<int>(dest, src, mask, site); }
+
+// Shared body of the masked two-operand arithmetic instructions
+#define __PP_NATIVE_BINOP(name, op)                                                                                                   \
+  template <typename T, int W>                                                                                                        \
+  inline void _pp_##name(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) \
+  {                                                                                                                                   \
+    typedef __pp_native<T, __pp_lanes<W>::value> R;                                                                                   \
+    __pp_native_chunks(mask, [&](int c, typename R::mask m) {                                                                         \
+      typename R::reg v = R::op(R::load(veca.value + c), R::load(vecb.value + c));                                                    \
+      R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), v, m));                                                    \
+    });                                                                                                                               \
+    PP_LOG(#name, mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask));                                           \
+  }
+
+__PP_NATIVE_BINOP(vadd, add)
+__PP_NATIVE_BINOP(vsub, sub)
+__PP_NATIVE_BINOP(vmult, mul)
+__PP_NATIVE_BINOP(vmin, min)
+__PP_NATIVE_BINOP(vmax, max)
+
+template <int W>
+inline void _pp_vadd_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vadd<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vadd_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vadd<int>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vsub_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vsub<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vsub_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vsub<int>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vmult_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmult<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vmult_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmult<int>(vecResult, veca, vecb, mask, site); }
+
+template <int W>
+inline void _pp_vdiv_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<float, __pp_lanes<W>::value> R;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    typename R::reg v = R::div(R::load(veca.value + c), R::load(vecb.value + c));
+    R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), v, m));
+  });
+  PP_LOG("vdiv", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask));
+}
+
+// x86 has no packed integer division; divide the active lanes one by one
+template <int W>
+inline void _pp_vdiv_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      vecResult.value[i] = veca.value[i] / vecb.value[i];
+  }
+  PP_LOG("vdiv", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &mask));
+}
+
+template <typename T, int W>
+inline void _pp_vabs(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), R::abs(R::load(veca.value + c)), m));
+  });
+  PP_LOG("vabs", mask.bits, W, site, __pp_deps(&vecResult, &veca, &mask));
+}
+
+template <int W>
+inline void _pp_vabs_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_mask_w<W> &mask, __pp_site site) { _pp_vabs<float>(vecResult, veca, mask, site); }
+template <int W>
+inline void _pp_vabs_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_mask_w<W> &mask, __pp_site site) { _pp_vabs<int>(vecResult, veca, mask, site); }
+
+// Shared body of the masked compare instructions
+#define __PP_NATIVE_CMPOP(name, op)                                                                                                    \
+  template <typename T, int W>                                                                                                         \
+  inline void _pp_##name(__pp_mask_w<W> &maskResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) \
+  {                                                                                                                                    \
+    typedef __pp_native<T, __pp_lanes<W>::value> R;                                                                                    \
+    typedef __pp_nmask<__pp_lanes<W>::value> M;                                                                                        \
+    unsigned long long result = 0;                                                                                                     \
+    for (int c = 0; c < W; c += __pp_lanes<W>::value)                                                                                  \
+    {                                                                                                                                  \
+      result |= M::bits(R::op(R::load(veca.value + c), R::load(vecb.value + c))) << c;                                                 \
+    }                                                                                                                                  \
+    maskResult.bits = (maskResult.bits & ~mask.bits) | (result & mask.bits);                                                           \
+    PP_LOG(#name, mask.bits, W, site, __pp_deps(&maskResult, &veca, &vecb, &mask));                                           \
+  }
+
+__PP_NATIVE_CMPOP(vgt, gt)
+__PP_NATIVE_CMPOP(vlt, lt)
+__PP_NATIVE_CMPOP(veq, eq)
+
+#undef __PP_NATIVE_BINOP
+#undef __PP_NATIVE_CMPOP
+
+template <int W>
+inline void _pp_vgt_float(__pp_mask_w<W> &maskResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgt<float>(maskResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vgt_int(__pp_mask_w<W> &maskResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgt<int>(maskResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vlt_float(__pp_mask_w<W> &maskResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vlt<float>(maskResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vlt_int(__pp_mask_w<W> &maskResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vlt<int>(maskResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_veq_float(__pp_mask_w<W> &maskResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_veq<float>(maskResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_veq_int(__pp_mask_w<W> &maskResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_veq<int>(maskResult, veca, vecb, mask, site); }
+
+template <int W>
+inline void _pp_hadd_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, __pp_site site)
+{
+  typedef __pp_native<float, __pp_lanes<W>::value> R;
+  if (W % 4 == 0)
+  {
+    for (int c = 0; c < W; c += __pp_lanes<W>::value)
+    {
+      typename R::reg v = R::load(vec.value + c);
+      R::store(vecResult.value + c, R::add(v, R::pairswap(v)));
+    }
+  }
+  else
+  {
+    // Partial registers, only whole pairs are added
+    for (int i = 0; i < W / 2; i++)
+    {
+      float result = vec.value[2 * i] + vec.value[2 * i + 1];
+      vecResult.value[2 * i] = result;
+      vecResult.value[2 * i + 1] = result;
+    }
+  }
+  PP_LOG("hadd", __pp_native_all<W>(), W, site, __pp_deps(&vecResult, &vec));
+}
+
+template <int W>
+inline void _pp_interleave_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> vec, __pp_site site)
+{
+#if PP_NATIVE_LANES == 8
+  if (W == 8)
+  {
+    __m256i index = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    _mm256_store_ps(vecResult.value, _mm256_permutevar8x32_ps(_mm256_load_ps(vec.value), index));
+    PP_LOG("interleave", __pp_native_all<W>(), W, site, __pp_deps(&vecResult));
+    return;
+  }
+#endif
+  if (W == 4)
+  {
+    __m128 v = _mm_load_ps(vec.value);
+    _mm_store_ps(vecResult.value, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 2, 0)));
+    PP_LOG("interleave", __pp_native_all<W>(), W, site, __pp_deps(&vecResult));
+    return;
+  }
+  // Other widths permute across native registers
+  for (int i = 0; i < W; i++)
+  {
+    int index = i < (W + 1) / 2 ? (2 * i) : (2 * (i - (W + 1) / 2) + 1);
+    vecResult.value[i] = vec.value[index];
+  }
+  PP_LOG("interleave", __pp_native_all<W>(), W, site, __pp_deps(&vecResult));
+}
+
+template <typename T, int W>
+inline T _pp_hreduce_add(__pp_vec<T, W> &vec, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  typename R::reg sum = R::set1(0);
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    sum = R::add(sum, R::blend(R::set1(0), R::load(vec.value + c), m));
+  });
+  PP_LOG("hreduce", mask.bits, W, site, __pp_deps(NULL, &vec, &mask));
+  return R::hsum(sum);
+}
+
+template <int W>
+inline float _pp_hreduce_add_float(__pp_vec<float, W> &vec, __pp_mask_w<W> &mask, __pp_site site) { return _pp_hreduce_add<float>(vec, mask, site); }
+template <int W>
+inline int _pp_hreduce_add_int(__pp_vec<int, W> &vec, __pp_mask_w<W> &mask, __pp_site site) { return _pp_hreduce_add<int>(vec, mask, site); }
+
+// Permutes cross native registers, so they run lane by lane except for a
+// single AVX2 register
+template <typename T, int W>
+inline void _pp_vpermute(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site)
+{
+#if PP_NATIVE_LANES == 8
+  if constexpr (W == 8)
+  {
+    typedef __pp_native<T, 8> R;
+    __m256i permuted = _mm256_permutevar8x32_epi32(_mm256_load_si256((const __m256i *)vec.value), _mm256_load_si256((const __m256i *)index.value));
+    typename R::reg v;
+    memcpy(&v, &permuted, sizeof(v));
+    R::store(vecResult.value, R::blend(R::load(vecResult.value), v, __pp_nmask<8>::load(mask.bits)));
+    PP_LOG("vpermute", mask.bits, W, site, __pp_deps(&vecResult, &vec, &index, &mask));
+    return;
+  }
+#endif
+  // vecResult may be vec
+  __pp_vec<T, W> src = vec;
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      vecResult.value[i] = src.value[index.value[i]];
+  }
+  PP_LOG("vpermute", mask.bits, W, site, __pp_deps(&vecResult, &vec, &index, &mask));
+}
+
+template <int W>
+inline void _pp_vpermute_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vpermute<float>(vecResult, vec, index, mask, site); }
+template <int W>
+inline void _pp_vpermute_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &vec, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vpermute<int>(vecResult, vec, index, mask, site); }
+
+template <typename T, int W>
+inline void _pp_vbroadcast(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  typename R::reg v = R::set1(vec.value[lane]);
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), v, m));
+  });
+  PP_LOG("vbroadcast", mask.bits, W, site, __pp_deps(&vecResult, &vec, &mask));
+}
+
+template <int W>
+inline void _pp_vbroadcast_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site) { _pp_vbroadcast<float>(vecResult, vec, lane, mask, site); }
+template <int W>
+inline void _pp_vbroadcast_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &vec, int lane, __pp_mask_w<W> &mask, __pp_site site) { _pp_vbroadcast<int>(vecResult, vec, lane, mask, site); }
+
+template <int W>
+inline void _pp_vfma_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_vec<float, W> &vecc, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<float, __pp_lanes<W>::value> R;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    typename R::reg v = R::fma(R::load(veca.value + c), R::load(vecb.value + c), R::load(vecc.value + c));
+    R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), v, m));
+  });
+  PP_LOG("vfma", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &vecc, &mask));
+}
+
+template <int W>
+inline void _pp_vmin_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmin<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vmin_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmin<int>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vmax_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmax<float>(vecResult, veca, vecb, mask, site); }
+template <int W>
+inline void _pp_vmax_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &mask, __pp_site site) { _pp_vmax<int>(vecResult, veca, vecb, mask, site); }
+
+template <typename T, int W>
+inline void _pp_vselect(__pp_vec<T, W> &vecResult, __pp_vec<T, W> &veca, __pp_vec<T, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site)
+{
+  typedef __pp_native<T, __pp_lanes<W>::value> R;
+  typedef __pp_nmask<__pp_lanes<W>::value> M;
+  __pp_native_chunks(mask, [&](int c, typename R::mask m) {
+    typename R::reg v = R::blend(R::load(vecb.value + c), R::load(veca.value + c), M::load(sel.bits >> c));
+    R::store(vecResult.value + c, R::blend(R::load(vecResult.value + c), v, m));
+  });
+  PP_LOG("vselect", mask.bits, W, site, __pp_deps(&vecResult, &veca, &vecb, &sel, &mask));
+}
+
+template <int W>
+inline void _pp_vselect_float(__pp_vec<float, W> &vecResult, __pp_vec<float, W> &veca, __pp_vec<float, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site) { _pp_vselect<float>(vecResult, veca, vecb, sel, mask, site); }
+template <int W>
+inline void _pp_vselect_int(__pp_vec<int, W> &vecResult, __pp_vec<int, W> &veca, __pp_vec<int, W> &vecb, __pp_mask_w<W> &sel, __pp_mask_w<W> &mask, __pp_site site) { _pp_vselect<int>(vecResult, veca, vecb, sel, mask, site); }
+
+// AVX2 gathers are no faster than scalar loads on most cores and x86 has no
+// scatter before AVX-512, so both run lane by lane
+template <typename T, int W>
+inline void _pp_vgather(__pp_vec<T, W> &dest, T *base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      dest.value[i] = base[index.value[i]];
+  }
+  PP_LOG("vgather", mask.bits, W, site, __pp_deps(&dest, &index, &mask));
+}
+
+template <int W>
+inline void _pp_vgather_float(__pp_vec<float, W> &dest, float *base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgather<float>(dest, base, index, mask, site); }
+template <int W>
+inline void _pp_vgather_int(__pp_vec<int, W> &dest, int *base, __pp_vec<int, W> &index, __pp_mask_w<W> &mask, __pp_site site) { _pp_vgather<int>(dest, base, index, mask, site); }
+
+template <typename T, int W>
+inline void _pp_vscatter(T *base, __pp_vec<int, W> &index, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      base[index.value[i]] = src.value[i];
+  }
+  PP_LOG("vscatter", mask.bits, W, site, __pp_deps(NULL, &index, &src, &mask));
+}
+
+template <int W>
+inline void _pp_vscatter_float(float *base, __pp_vec<int, W> &index, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vscatter<float>(base, index, src, mask, site); }
+template <int W>
+inline void _pp_vscatter_int(int *base, __pp_vec<int, W> &index, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { _pp_vscatter<int>(base, index, src, mask, site); }
+
+// AVX2 has no compress/expand, so both run lane by lane
+template <typename T, int W>
+inline int _pp_vcompress(T *dest, __pp_vec<T, W> &src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  int count = 0;
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      dest[count++] = src.value[i];
+  }
+  PP_LOG("vcompress", mask.bits, W, site, __pp_deps(NULL, &src, &mask));
+  return count;
+}
+
+template <int W>
+inline int _pp_vcompress_float(float *dest, __pp_vec<float, W> &src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vcompress<float>(dest, src, mask, site); }
+template <int W>
+inline int _pp_vcompress_int(int *dest, __pp_vec<int, W> &src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vcompress<int>(dest, src, mask, site); }
+
+template <typename T, int W>
+inline int _pp_vexpand(__pp_vec<T, W> &dest, T *src, __pp_mask_w<W> &mask, __pp_site site)
+{
+  int count = 0;
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask.bits >> i) & 1)
+      dest.value[i] = src[count++];
+  }
+  PP_LOG("vexpand", mask.bits, W, site, __pp_deps(&dest, &mask));
+  return count;
+}
+
+template <int W>
+inline int _pp_vexpand_float(__pp_vec<float, W> &dest, float *src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vexpand<float>(dest, src, mask, site); }
+template <int W>
+inline int _pp_vexpand_int(__pp_vec<int, W> &dest, int *src, __pp_mask_w<W> &mask, __pp_site site) { return _pp_vexpand<int>(dest, src, mask, site); }
+
+#endif
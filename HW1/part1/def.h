@@ -3,3 +3,5 @@
 #define VECTOR_WIDTH 4
 #endif
 #define EXP_MAX 10
+// Widest vector the PP intrinsics are instantiated for
+#define MAX_VECTOR_WIDTH 64
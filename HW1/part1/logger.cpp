@@ -1,66 +1,627 @@
 #include "logger.h"
 #include "PPintrin.h"
+#include "machine_model.h"
+#include <algorithm>
+#include <map>
 
-void Logger::addLog(const char *instruction, __pp_mask mask, int N)
+// Records per stream buffer, and how many full buffers may wait for the flush
+// thread before addLog blocks (bounds the memory of LOG_STREAM)
+#define TRACE_BUFFER_RECORDS (1 << 16)
+#define TRACE_MAX_PENDING 4
+
+static const char TRACE_MAGIC[8] = {'P', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// A trace file is a TraceHeader, the TraceRecords, the name table (one length
+// byte plus the characters per name) and a TraceTrailer
+struct TraceHeader {
+  char magic[8];
+  unsigned int vectorWidth;
+  unsigned int reserved;
+};
+
+struct TraceTrailer {
+  unsigned long long records;
+  unsigned int names;
+  unsigned int reserved;
+  char magic[8];
+};
+
+Logger::~Logger()
 {
-  Log newLog;
-  strcpy(newLog.instruction, instruction);
-  newLog.mask = 0;
-  for (int i = 0; i < N; i++)
+  closeStream();
+  for (Logger *thread : threads)
+    delete thread;
+  delete ownMachine;
+}
+
+Logger *Logger::newThreadLogger()
+{
+  Logger *child = new Logger();
+  if (mode == LOG_RING)
+    child->setRing(ringSize);
+  else
+    child->mode = mode == LOG_STATS ? LOG_STATS : LOG_FULL;
+  child->width = width;
+  child->profile = profile;
+  if (machine)
+  {
+    child->ownMachine = new MachineModel(*machine);
+    child->ownMachine->reset();
+    child->machine = child->ownMachine;
+  }
+  lock_guard<mutex> lock(threadsLock);
+  threads.push_back(child);
+  return child;
+}
+
+void Logger::mergeThreads()
+{
+  lock_guard<mutex> lock(threadsLock);
+  if (threads.empty())
+    return;
+
+  vector<const MachineModel *> cores;
+  for (Logger *thread : threads)
   {
-    if (mask.value[i])
+    stats.utilized_lane += thread->stats.utilized_lane;
+    stats.total_lane += thread->stats.total_lane;
+    stats.total_instructions += thread->stats.total_instructions;
+    for (int i = 0; i < PP_ELEMENT_SIZES; i++)
     {
-      newLog.mask |= (((unsigned long long)1) << i);
-      stats.utilized_lane++;
+      elementStats[i].utilized_lane += thread->elementStats[i].utilized_lane;
+      elementStats[i].total_lane += thread->elementStats[i].total_lane;
+      elementStats[i].total_instructions += thread->elementStats[i].total_instructions;
+    }
+    for (auto &entry : thread->sites)
+    {
+      Statistics &site = sites[entry.first];
+      site.utilized_lane += entry.second.utilized_lane;
+      site.total_lane += entry.second.total_lane;
+      site.total_instructions += entry.second.total_instructions;
+    }
+    if (thread->machine)
+      cores.push_back(thread->machine);
+
+    // Replay the kept log entries in order
+    size_t kept = thread->mode == LOG_RING ? min((size_t)thread->ringTotal, thread->ringSize) : thread->log.size();
+    size_t first = thread->mode == LOG_RING ? thread->ringNext + thread->ringSize - kept : 0;
+    for (size_t i = 0; mode != LOG_STATS && i < kept; i++)
+    {
+      const Log &entry = thread->log[(first + i) % thread->log.size()];
+      // The names of copied entries are not literals, so intern them by name
+      // to keep the pointer table small
+      auto byName = opByName.find(entry.instruction);
+      if (mode == LOG_STREAM && byName != opByName.end())
+      {
+        TraceRecord record = {entry.mask, byName->second, (unsigned char)entry.width, 0};
+        streamBuf.push_back(record);
+        if (streamBuf.size() == TRACE_BUFFER_RECORDS)
+          handOff();
+      }
+      else if (mode == LOG_FULL)
+        log.push_back(entry);
+      else
+        pushLog(entry.instruction, entry.mask, entry.width);
     }
   }
-  stats.total_lane += N;
-  stats.total_instructions += (N > 0);
+  if (machine && !cores.empty())
+    machine->addParallel(cores);
+
+  for (Logger *thread : threads)
+    delete thread;
+  threads.clear();
+}
+
+void Logger::issue(const char *instruction, unsigned long long mask, int N, const __pp_deps &deps)
+{
+  machine->issue(instruction, __builtin_popcountll(mask) < N, deps);
+}
+
+void Logger::pushLog(const char *instruction, unsigned long long mask, int N)
+{
+  if (mode == LOG_STREAM)
+  {
+    TraceRecord record;
+    record.mask = mask;
+    record.op = internOp(instruction);
+    record.width = (unsigned char)N;
+    record.reserved = 0;
+    streamBuf.push_back(record);
+    if (streamBuf.size() == TRACE_BUFFER_RECORDS)
+      handOff();
+    return;
+  }
+
+  Log newLog;
+  strncpy(newLog.instruction, instruction, MAX_INST_LEN - 1);
+  newLog.instruction[MAX_INST_LEN - 1] = '\0';
+  newLog.mask = mask;
+  newLog.width = N;
+  if (mode == LOG_RING)
+  {
+    log[ringNext] = newLog;
+    ringNext = (ringNext + 1) % ringSize;
+    ringTotal++;
+    return;
+  }
   log.push_back(newLog);
 }
 
+unsigned short Logger::internOp(const char *instruction)
+{
+  // Instruction names are almost always string literals, so look them up by
+  // address first and only fall back to the characters for user logs
+  auto byPtr = opByPtr.find(instruction);
+  if (byPtr != opByPtr.end() && opNames[byPtr->second] == instruction)
+    return byPtr->second;
+
+  string name(instruction, strnlen(instruction, MAX_INST_LEN - 1));
+  auto byName = opByName.find(name);
+  unsigned short op;
+  if (byName != opByName.end())
+  {
+    op = byName->second;
+  }
+  else
+  {
+    op = (unsigned short)opNames.size();
+    opNames.push_back(name);
+    opByName[name] = op;
+  }
+  opByPtr[instruction] = op;
+  return op;
+}
+
+void Logger::handOff()
+{
+  unique_lock<mutex> lock(flushLock);
+  flushDone.wait(lock, [this] { return pending.size() < TRACE_MAX_PENDING; });
+  traceRecords += streamBuf.size();
+  pending.push_back(move(streamBuf));
+  if (!spare.empty())
+  {
+    streamBuf = move(spare.back());
+    spare.pop_back();
+  }
+  else
+  {
+    streamBuf = vector<TraceRecord>();
+    streamBuf.reserve(TRACE_BUFFER_RECORDS);
+  }
+  flushReady.notify_one();
+}
+
+void Logger::flushLoop()
+{
+  unique_lock<mutex> lock(flushLock);
+  while (true)
+  {
+    flushReady.wait(lock, [this] { return flushStop || !pending.empty(); });
+    if (pending.empty())
+      return;
+    vector<TraceRecord> buffer = move(pending.front());
+    pending.erase(pending.begin());
+    writing = true;
+
+    lock.unlock();
+    fwrite(buffer.data(), sizeof(TraceRecord), buffer.size(), traceFile);
+    buffer.clear();
+    lock.lock();
+
+    writing = false;
+    spare.push_back(move(buffer));
+    flushDone.notify_one();
+  }
+}
+
+void Logger::setStatsOnly()
+{
+  closeStream();
+  mode = LOG_STATS;
+  log.clear();
+}
+
+void Logger::setRing(size_t entries)
+{
+  closeStream();
+  mode = LOG_RING;
+  ringSize = entries > 0 ? entries : 1;
+  ringNext = 0;
+  ringTotal = 0;
+  log.assign(ringSize, Log());
+}
+
+bool Logger::setStream(const char *path)
+{
+  closeStream();
+  traceFile = fopen(path, "wb");
+  if (!traceFile)
+    return false;
+
+  TraceHeader header;
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.vectorWidth = width;
+  header.reserved = 0;
+  fwrite(&header, sizeof(header), 1, traceFile);
+
+  mode = LOG_STREAM;
+  tracePath = path;
+  log.clear();
+  traceRecords = 0;
+  streamBuf.clear();
+  streamBuf.reserve(TRACE_BUFFER_RECORDS);
+  flushStop = false;
+  flushThread = thread(&Logger::flushLoop, this);
+  return true;
+}
+
+void Logger::syncStream()
+{
+  if (!streamBuf.empty())
+    handOff();
+  unique_lock<mutex> lock(flushLock);
+  flushDone.wait(lock, [this] { return pending.empty() && !writing; });
+  fflush(traceFile);
+}
+
+void Logger::closeStream()
+{
+  if (!traceFile)
+    return;
+
+  mergeThreads();
+  syncStream();
+  {
+    lock_guard<mutex> lock(flushLock);
+    flushStop = true;
+  }
+  flushReady.notify_one();
+  flushThread.join();
+
+  for (size_t i = 0; i < opNames.size(); i++)
+  {
+    unsigned char len = (unsigned char)opNames[i].size();
+    fwrite(&len, 1, 1, traceFile);
+    fwrite(opNames[i].data(), 1, len, traceFile);
+  }
+  TraceTrailer trailer;
+  trailer.records = traceRecords;
+  trailer.names = (unsigned int)opNames.size();
+  trailer.reserved = 0;
+  memcpy(trailer.magic, TRACE_MAGIC, sizeof(trailer.magic));
+  fwrite(&trailer, sizeof(trailer), 1, traceFile);
+  fclose(traceFile);
+  traceFile = NULL;
+
+  spare.clear();
+  streamBuf = vector<TraceRecord>();
+  opNames.clear();
+  opByPtr.clear();
+  opByName.clear();
+  mode = LOG_STATS;
+}
+
 void Logger::printStats()
 {
+  mergeThreads();
   printf("****************** Printing Vector Unit Statistics *******************\n");
-  printf("Vector Width:              %d\n", VECTOR_WIDTH);
+#ifdef PP_NOLOG
+  printf("Not collected: built with NOLOG=1\n");
+  return;
+#endif
+  printf("Vector Width:              %d\n", width);
   printf("Total Vector Instructions: %lld\n", stats.total_instructions);
   printf("Vector Utilization:        %.1f%%\n", (double)stats.utilized_lane / stats.total_lane * 100);
   printf("Utilized Vector Lanes:     %lld\n", stats.utilized_lane);
   printf("Total Vector Lanes:        %lld\n", stats.total_lane);
+  // Break the lanes down by element size once anything but 32-bit lanes ran
+  if (elementStats[2].total_instructions != stats.total_instructions)
+  {
+    printf("Element Size | Instructions | Utilized Lanes | Total Lanes | Utilization\n");
+    for (int i = 0; i < PP_ELEMENT_SIZES; i++)
+    {
+      const Statistics &element = elementStats[i];
+      if (element.total_instructions == 0)
+        continue;
+      printf("%8d-bit | %12lld | %14lld | %11lld | %10.1f%%\n", 8 << i, element.total_instructions,
+             element.utilized_lane, element.total_lane, (double)element.utilized_lane / element.total_lane * 100);
+    }
+  }
+  if (machine)
+    machine->printEstimate();
 }
 
-void Logger::printLog()
+static void printLogHeader()
 {
   printf("***************** Printing Vector Unit Execution Log *****************\n");
   printf(" Instruction | Vector Lane Occupancy ('*' for active, '_' for inactive)\n");
   printf("------------- --------------------------------------------------------\n");
-  for (int i = 0; i < log.size(); i++)
+}
+
+// User logs have no width of their own and are drawn userWidth lanes wide
+static void printLogLine(const char *instruction, unsigned long long mask, int width, int userWidth)
+{
+  if (width == 0)
+    width = userWidth;
+  printf("%12s | ", instruction);
+  for (int j = 0; j < width; j++)
+  {
+    if (mask & (((unsigned long long)1) << j))
+    {
+      printf("*");
+    }
+    else
+    {
+      printf("_");
+    }
+  }
+  printf("\n");
+}
+
+// Print count records starting at the current position of a trace file
+static void printTraceRecords(FILE *file, unsigned long long count, const vector<string> &names, int userWidth)
+{
+  vector<TraceRecord> buffer(TRACE_BUFFER_RECORDS);
+  while (count > 0)
+  {
+    size_t want = count < buffer.size() ? (size_t)count : buffer.size();
+    size_t got = fread(buffer.data(), sizeof(TraceRecord), want, file);
+    for (size_t i = 0; i < got; i++)
+    {
+      const char *name = buffer[i].op < names.size() ? names[buffer[i].op].c_str() : "?";
+      printLogLine(name, buffer[i].mask, buffer[i].width, userWidth);
+    }
+    if (got < want)
+      break;
+    count -= got;
+  }
+}
+
+void Logger::printLog()
+{
+  mergeThreads();
+  if (mode == LOG_STREAM)
+  {
+    // Read back what has been streamed so far
+    syncStream();
+    FILE *file = fopen(tracePath.c_str(), "rb");
+    if (!file)
+    {
+      printf("Error: cannot open trace %s\n", tracePath.c_str());
+      return;
+    }
+    printLogHeader();
+    fseek(file, sizeof(TraceHeader), SEEK_SET);
+    printTraceRecords(file, traceRecords, opNames, width);
+    fclose(file);
+    return;
+  }
+
+  printLogHeader();
+  if (mode == LOG_STATS)
   {
-    printf("%12s | ", log[i].instruction);
-    for (int j = 0; j < VECTOR_WIDTH; j++)
+    printf("(execution log disabled, only statistics were kept)\n");
+    return;
+  }
+  if (mode == LOG_RING)
+  {
+    size_t kept = ringTotal < ringSize ? ringTotal : ringSize;
+    if (ringTotal > kept)
+      printf("(last %zu of %llu instructions)\n", kept, ringTotal);
+    for (size_t i = 0; i < kept; i++)
     {
-      if (log[i].mask & (((unsigned long long)1) << j))
+      const Log &entry = log[(ringNext + ringSize - kept + i) % ringSize];
+      printLogLine(entry.instruction, entry.mask, entry.width, width);
+    }
+    return;
+  }
+  for (size_t i = 0; i < log.size(); i++)
+  {
+    printLogLine(log[i].instruction, log[i].mask, log[i].width, width);
+  }
+}
+
+bool printTrace(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+  {
+    printf("Error: cannot open trace %s\n", path);
+    return false;
+  }
+
+  TraceHeader header;
+  TraceTrailer trailer;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1
+               && memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) == 0
+               && fseek(file, -(long)sizeof(trailer), SEEK_END) == 0
+               && fread(&trailer, sizeof(trailer), 1, file) == 1
+               && memcmp(trailer.magic, TRACE_MAGIC, sizeof(trailer.magic)) == 0;
+
+  // The name table follows the records
+  vector<string> names;
+  if (valid)
+    valid = fseek(file, (long)(sizeof(header) + trailer.records * sizeof(TraceRecord)), SEEK_SET) == 0;
+  for (unsigned int i = 0; valid && i < trailer.names; i++)
+  {
+    unsigned char len;
+    char name[256];
+    valid = fread(&len, 1, 1, file) == 1 && fread(name, 1, len, file) == len;
+    names.push_back(string(name, valid ? len : 0));
+  }
+  if (!valid)
+  {
+    printf("Error: %s is not a complete PP trace\n", path);
+    fclose(file);
+    return false;
+  }
+
+  printLogHeader();
+  fseek(file, sizeof(header), SEEK_SET);
+  printTraceRecords(file, trailer.records, names, header.vectorWidth);
+  fclose(file);
+  return true;
+}
+
+// One row of the hotspot tables
+struct ProfileRow {
+  string op;
+  string file; // empty in the per-opcode table
+  int line;
+  Statistics stats;
+};
+
+static bool moreWasted(const ProfileRow &a, const ProfileRow &b)
+{
+  unsigned long long wastedA = a.stats.total_lane - a.stats.utilized_lane;
+  unsigned long long wastedB = b.stats.total_lane - b.stats.utilized_lane;
+  if (wastedA != wastedB)
+    return wastedA > wastedB;
+  return a.stats.total_instructions > b.stats.total_instructions;
+}
+
+// Merge the pointer-keyed profile by name and sort both tables by wasted lanes
+static void buildProfile(const unordered_map<SiteKey, Statistics, SiteKeyHash> &sites,
+                         vector<ProfileRow> &opRows, vector<ProfileRow> &siteRows)
+{
+  map<string, Statistics> byOp;
+  map<pair<pair<string, int>, string>, Statistics> bySite;
+  for (auto &entry : sites)
+  {
+    const SiteKey &key = entry.first;
+    Statistics &op = byOp[key.op];
+    Statistics &site = bySite[make_pair(make_pair(string(key.file ? key.file : "?"), key.line), string(key.op))];
+    for (Statistics *s : {&op, &site})
+    {
+      s->total_instructions += entry.second.total_instructions;
+      s->utilized_lane += entry.second.utilized_lane;
+      s->total_lane += entry.second.total_lane;
+    }
+  }
+  opRows.clear();
+  siteRows.clear();
+  for (auto &entry : byOp)
+    opRows.push_back(ProfileRow{entry.first, "", 0, entry.second});
+  for (auto &entry : bySite)
+    siteRows.push_back(ProfileRow{entry.first.second, entry.first.first.first, entry.first.first.second, entry.second});
+  sort(opRows.begin(), opRows.end(), moreWasted);
+  sort(siteRows.begin(), siteRows.end(), moreWasted);
+}
+
+static double utilization(const Statistics &s)
+{
+  return s.total_lane ? (double)s.utilized_lane / s.total_lane * 100 : 0.0;
+}
+
+void Logger::printProfile()
+{
+  mergeThreads();
+  vector<ProfileRow> opRows, siteRows;
+  buildProfile(sites, opRows, siteRows);
+
+  printf("******************* Vector Utilization by Opcode *********************\n");
+  printf(" Instruction |    Count |  Utilization | Wasted Lanes\n");
+  for (const ProfileRow &row : opRows)
+  {
+    printf("%12s | %8llu | %11.1f%% | %llu\n", row.op.c_str(), row.stats.total_instructions,
+           utilization(row.stats), row.stats.total_lane - row.stats.utilized_lane);
+  }
+  printf("****************** Vector Utilization by Call Site *******************\n");
+  printf(" Instruction |    Count |  Utilization | Wasted Lanes | Source\n");
+  for (const ProfileRow &row : siteRows)
+  {
+    printf("%12s | %8llu | %11.1f%% | %12llu | %s:%d\n", row.op.c_str(), row.stats.total_instructions,
+           utilization(row.stats), row.stats.total_lane - row.stats.utilized_lane, row.file.c_str(), row.line);
+  }
+}
+
+bool Logger::writeProfile(const char *path)
+{
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return false;
+
+  mergeThreads();
+  vector<ProfileRow> opRows, siteRows;
+  buildProfile(sites, opRows, siteRows);
+
+  size_t len = strlen(path);
+  bool json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+  if (json)
+  {
+    fprintf(file, "{\n  \"vector_width\": %d,\n", width);
+    for (int table = 0; table < 2; table++)
+    {
+      const vector<ProfileRow> &rows = table == 0 ? opRows : siteRows;
+      fprintf(file, "  \"%s\": [", table == 0 ? "opcodes" : "sites");
+      for (size_t i = 0; i < rows.size(); i++)
       {
-        printf("*");
+        const ProfileRow &row = rows[i];
+        fprintf(file, "%s\n    {\"opcode\": \"%s\", ", i ? "," : "", row.op.c_str());
+        if (table == 1)
+          fprintf(file, "\"file\": \"%s\", \"line\": %d, ", row.file.c_str(), row.line);
+        fprintf(file, "\"instructions\": %llu, \"utilized_lanes\": %llu, \"total_lanes\": %llu, "
+                      "\"utilization\": %.4f, \"wasted_lanes\": %llu}",
+                row.stats.total_instructions, row.stats.utilized_lane, row.stats.total_lane,
+                utilization(row.stats) / 100, row.stats.total_lane - row.stats.utilized_lane);
       }
-      else
+      fprintf(file, "\n  ]%s\n", table == 0 ? "," : "");
+    }
+    fprintf(file, "}\n");
+  }
+  else
+  {
+    fprintf(file, "scope,opcode,file,line,instructions,utilized_lanes,total_lanes,utilization,wasted_lanes\n");
+    for (int table = 0; table < 2; table++)
+    {
+      const vector<ProfileRow> &rows = table == 0 ? opRows : siteRows;
+      for (const ProfileRow &row : rows)
       {
-        printf("_");
+        fprintf(file, "%s,%s,%s,%d,%llu,%llu,%llu,%.4f,%llu\n", table == 0 ? "opcode" : "site",
+                row.op.c_str(), row.file.c_str(), row.line, row.stats.total_instructions,
+                row.stats.utilized_lane, row.stats.total_lane, utilization(row.stats) / 100,
+                row.stats.total_lane - row.stats.utilized_lane);
       }
     }
-    printf("\n");
   }
+  fclose(file);
+  return true;
 }
 
 void Logger::refresh()
 {
+  mergeThreads();
   stats.total_instructions = 0;
   stats.total_lane = 0;
   stats.utilized_lane = 0;
+  for (Statistics &element : elementStats)
+    element = Statistics();
+  sites.clear();
+  if (machine)
+    machine->reset();
   fflush(stdout);
 };
 
 unsigned long long Logger::getTotalInstrs()
 {
+  mergeThreads();
   return stats.total_instructions;
 }
+
+Statistics Logger::getStats()
+{
+  mergeThreads();
+  return stats;
+}
+
+Statistics Logger::getElementStats(int elementBytes)
+{
+  mergeThreads();
+  return elementStats[__builtin_ctz(elementBytes) & (PP_ELEMENT_SIZES - 1)];
+}
+
+double Logger::getCycles()
+{
+  mergeThreads();
+  return machine ? machine->getCycles() : 0;
+}
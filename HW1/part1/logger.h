@@ -4,15 +4,49 @@
 #include <stdio.h>
 #include <vector>
 #include <string.h>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "def.h"
 using namespace std;
 
 #define MAX_INST_LEN 32
 
-struct __pp_mask;
+// Source location of a PP intrinsic call. It is the defaulted last argument of
+// every intrinsic, so __builtin_FILE()/__builtin_LINE() expand at the caller.
+struct __pp_site {
+  const char *file;
+  int line;
+  __pp_site(const char *file = __builtin_FILE(), int line = __builtin_LINE()) : file(file), line(line) {}
+};
+
+// Registers written and read by one instruction, identified by address. The
+// machine model follows these to find the data dependencies of a kernel.
+struct __pp_deps {
+  const void *dest;
+  const void *src[4];
+  __pp_deps(const void *dest = NULL, const void *a = NULL, const void *b = NULL, const void *c = NULL,
+            const void *d = NULL)
+      : dest(dest), src{a, b, c, d} {}
+};
+
+class MachineModel;
 
 struct Log {
   char instruction[MAX_INST_LEN];
   unsigned long long mask; // support vector width up to 64
+  int width; // 0 for user logs
+};
+
+// Compact form of a Log written to a binary trace, the instruction name is an
+// index into the name table stored at the end of the trace file
+struct __attribute__((packed)) TraceRecord {
+  unsigned long long mask;
+  unsigned short op;
+  unsigned char width; // 0 for user logs
+  unsigned char reserved;
 };
 
 struct Statistics {
@@ -21,17 +55,162 @@ struct Statistics {
   unsigned long long total_instructions;
 };
 
+// Statistics are also kept per element size of 1, 2, 4 and 8 bytes
+#define PP_ELEMENT_SIZES 4
+
+// Profile of one opcode at one call site
+struct SiteKey {
+  const char *file;
+  int line;
+  const char *op;
+  bool operator==(const SiteKey &other) const { return file == other.file && line == other.line && op == other.op; }
+};
+
+struct SiteKeyHash {
+  size_t operator()(const SiteKey &key) const
+  {
+    return hash<const void *>()(key.file) ^ (hash<const void *>()(key.op) * 31) ^ ((size_t)key.line << 1);
+  }
+};
+
+// What the Logger keeps besides the statistics
+enum LogMode {
+  LOG_FULL,   // every instruction in memory (default)
+  LOG_STATS,  // statistics only
+  LOG_RING,   // the last ringSize instructions
+  LOG_STREAM  // every instruction, streamed to a binary trace file
+};
+
 class Logger {
   private:
     vector<Log> log;
     Statistics stats;
+    // Indexed by log2 of the element size, instructions without an element
+    // type (mask operations, user logs) count as 32-bit
+    Statistics elementStats[PP_ELEMENT_SIZES] = {};
+    LogMode mode = LOG_FULL;
+    // Width of the most recent vector instruction, kernels may run at any
+    // width up to MAX_VECTOR_WIDTH
+    int width = VECTOR_WIDTH;
+
+    // LOG_RING
+    size_t ringSize = 0;
+    size_t ringNext = 0;
+    unsigned long long ringTotal = 0;
+
+    // LOG_STREAM: full buffers are handed to flushThread, which writes them out
+    FILE *traceFile = NULL;
+    string tracePath;
+    vector<TraceRecord> streamBuf;
+    vector<vector<TraceRecord>> pending;
+    vector<vector<TraceRecord>> spare;
+    unsigned long long traceRecords = 0;
+    vector<string> opNames;
+    unordered_map<const char *, unsigned short> opByPtr;
+    unordered_map<string, unsigned short> opByName;
+    thread flushThread;
+    mutex flushLock;
+    condition_variable flushReady;
+    condition_variable flushDone;
+    bool flushStop = false;
+    bool writing = false;
+
+    // Per-opcode / per-call-site profile, keyed by the literal pointers
+    bool profile = false;
+    unordered_map<SiteKey, Statistics, SiteKeyHash> sites;
+
+    MachineModel *machine = NULL;
+
+    // Per-thread loggers, merged into this one in creation order the next
+    // time its results are read. A thread logger owns a copy of the machine
+    // model, since the model keeps a schedule.
+    vector<Logger *> threads;
+    mutex threadsLock;
+    MachineModel *ownMachine = NULL;
+    // Logger of the calling worker thread, NULL when it logs to PPLogger
+    static inline thread_local Logger *current = NULL;
+
+    void mergeThreads();
+    void pushLog(const char * instruction, unsigned long long mask, int N);
+    void issue(const char * instruction, unsigned long long mask, int N, const __pp_deps &deps);
+    unsigned short internOp(const char * instruction);
+    void handOff();
+    // Wait until every record so far is in the trace file
+    void syncStream();
+    void flushLoop();
 
   public:
-    void addLog(const char * instruction, __pp_mask mask, int N = 0);
+    ~Logger();
+    // mask holds one bit per lane, N is the vector width (0 for user logs)
+    // and elementBytes the size of one lane
+    inline void addLog(const char * instruction, unsigned long long mask, int N, const __pp_site &site,
+                       const __pp_deps &deps = __pp_deps(), int elementBytes = 4)
+    {
+      if (current && current != this)
+      {
+        current->addLog(instruction, mask, N, site, deps, elementBytes);
+        return;
+      }
+      stats.utilized_lane += __builtin_popcountll(mask);
+      stats.total_lane += N;
+      stats.total_instructions += (N > 0);
+      Statistics &element = elementStats[__builtin_ctz(elementBytes) & (PP_ELEMENT_SIZES - 1)];
+      element.utilized_lane += __builtin_popcountll(mask);
+      element.total_lane += N;
+      element.total_instructions += (N > 0);
+      if (N > 0)
+        width = N;
+      if (profile && N > 0)
+      {
+        Statistics &entry = sites[SiteKey{site.file, site.line, instruction}];
+        entry.utilized_lane += __builtin_popcountll(mask);
+        entry.total_lane += N;
+        entry.total_instructions++;
+      }
+      if (machine && N > 0)
+        issue(instruction, mask, N, deps);
+      if (mode != LOG_STATS)
+        pushLog(instruction, mask, N);
+    }
+    void setStatsOnly();
+    void setRing(size_t entries);
+    // Returns false if the trace file cannot be created
+    bool setStream(const char * path);
+    // Write out the buffered records and the name table of a LOG_STREAM trace,
+    // the Logger keeps only statistics afterwards
+    void closeStream();
+    LogMode getMode() { return mode; }
+    int getWidth() { return width; }
+    // Collect instruction and lane counts per opcode and per call site
+    void setProfile(bool enable) { profile = enable; }
+    // Hotspot tables sorted by wasted (inactive) lanes
+    void printProfile();
+    // Export the profile as CSV, or JSON when path ends in .json
+    bool writeProfile(const char * path);
+    // Estimate cycles and the critical path with a cost model (NULL disables)
+    void setMachineModel(MachineModel *model) { machine = model; }
     void printStats();
     void printLog();
     void refresh();
     unsigned long long getTotalInstrs();
+    Statistics getStats();
+    // Statistics of the instructions on elements of elementBytes bytes
+    Statistics getElementStats(int elementBytes);
+    // Estimated cycles of the machine model, 0 without one
+    double getCycles();
+
+    // Create a logger for one worker thread with the mode, profile and
+    // machine model of this one (a LOG_STREAM logger gets an in-memory log
+    // that is streamed at merge time). Statistics, logs and profiles are
+    // added up exactly; the cycles of the thread loggers count as one
+    // parallel section that lasts as long as the slowest thread.
+    Logger *newThreadLogger();
+    // Send the instructions of the calling thread to logger (NULL: back to
+    // the logger they are issued on)
+    static void setThreadLogger(Logger *logger) { current = logger; }
 };
 
+// Print a trace written in LOG_STREAM mode, returns false if it is unreadable
+bool printTrace(const char * path);
+
 #endif
@@ -0,0 +1,186 @@
+#include "machine_model.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+MachineModel::MachineModel() : name("uniform (1 cycle, in order)"), width(1), window(1)
+{
+  fallback.latency = 1;
+  fallback.throughput = 1;
+  fallback.port = portIndex("any");
+  reset();
+}
+
+MachineModel::MachineModel(const MachineModel &other)
+    : name(other.name), costs(other.costs), fallback(other.fallback), ports(other.ports), width(other.width),
+      window(other.window), portBusy(other.ports.size(), 0.0)
+{
+  reset();
+}
+
+int MachineModel::portIndex(const string &port)
+{
+  for (size_t i = 0; i < ports.size(); i++)
+  {
+    if (ports[i] == port)
+      return (int)i;
+  }
+  ports.push_back(port);
+  portBusy.push_back(0);
+  return (int)ports.size() - 1;
+}
+
+bool MachineModel::load(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (!file)
+  {
+    printf("Error: cannot open machine model %s\n", path);
+    return false;
+  }
+
+  char line[256];
+  int lineNo = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file))
+  {
+    lineNo++;
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+
+    char op[64], port[64], extra[2];
+    OpCost opCost;
+    int fields = sscanf(line, "%63s %lf %lf %63s %1s", op, &opCost.latency, &opCost.throughput, port, extra);
+    if (fields <= 0)
+      continue;
+    if (fields == 2 && strcmp(op, "width") == 0 && opCost.latency >= 1)
+    {
+      width = (int)opCost.latency;
+      continue;
+    }
+    if (fields == 2 && strcmp(op, "window") == 0 && opCost.latency >= 1)
+    {
+      window = (int)opCost.latency;
+      continue;
+    }
+    if (fields != 4 || opCost.latency < 0 || opCost.throughput < 0)
+    {
+      printf("Error: %s:%d: expected <opcode> <latency> <throughput> <port>\n", path, lineNo);
+      ok = false;
+      break;
+    }
+    opCost.port = portIndex(port);
+    if (strcmp(op, "default") == 0)
+      fallback = opCost;
+    else
+      costs[op] = opCost;
+  }
+  fclose(file);
+
+  if (ok)
+    name = path;
+  byPtr.clear();
+  reset();
+  return ok;
+}
+
+const OpCost &MachineModel::cost(const char *instruction)
+{
+  auto cached = byPtr.find(instruction);
+  if (cached != byPtr.end())
+    return *cached->second;
+
+  auto found = costs.find(instruction);
+  const OpCost *opCost = found != costs.end() ? &found->second : &fallback;
+  byPtr[instruction] = opCost;
+  return *opCost;
+}
+
+void MachineModel::issue(const char *instruction, bool partial, const __pp_deps &deps)
+{
+  const OpCost &opCost = cost(instruction);
+
+  // Wait for the issue slot and for a free window entry
+  double start = (double)(instructions / width);
+  start = max(start, retired[instructions % window]);
+  double chainStart = 0;
+  for (int i = 0; i < 5; i++)
+  {
+    const void *src = i < 4 ? deps.src[i] : (partial ? deps.dest : NULL);
+    if (!src)
+      continue;
+    auto r = ready.find(src);
+    if (r != ready.end())
+      start = max(start, r->second);
+    auto c = chain.find(src);
+    if (c != chain.end())
+      chainStart = max(chainStart, c->second);
+  }
+
+  double finish = start + opCost.latency;
+  lastRetire = max(lastRetire, finish);
+  retired[instructions % window] = lastRetire;
+  portBusy[opCost.port] += opCost.throughput;
+  cycles = max(cycles, max(finish, portBusy[opCost.port]));
+  criticalPath = max(criticalPath, chainStart + opCost.latency);
+  if (deps.dest)
+  {
+    ready[deps.dest] = finish;
+    chain[deps.dest] = chainStart + opCost.latency;
+  }
+  instructions++;
+}
+
+void MachineModel::reset()
+{
+  ready.clear();
+  chain.clear();
+  retired.assign(window, 0.0);
+  lastRetire = 0;
+  fill(portBusy.begin(), portBusy.end(), 0.0);
+  cycles = 0;
+  criticalPath = 0;
+  instructions = 0;
+  parallelInstructions = 0;
+}
+
+void MachineModel::addParallel(const vector<const MachineModel *> &cores)
+{
+  double longest = 0;
+  double longestPath = 0;
+  for (const MachineModel *core : cores)
+  {
+    longest = max(longest, core->cycles);
+    longestPath = max(longestPath, core->criticalPath);
+    parallelInstructions += core->instructions + core->parallelInstructions;
+  }
+  for (size_t p = 0; p < portBusy.size(); p++)
+  {
+    double busiest = 0;
+    for (const MachineModel *core : cores)
+      busiest = max(busiest, p < core->portBusy.size() ? core->portBusy[p] : 0.0);
+    portBusy[p] += busiest;
+  }
+
+  // Nothing after the section issues before it ends
+  cycles = max(cycles, lastRetire) + longest;
+  lastRetire = cycles;
+  retired.assign(window, cycles);
+  criticalPath += longestPath;
+}
+
+void MachineModel::printEstimate()
+{
+  int bottleneck = 0;
+  for (size_t i = 1; i < portBusy.size(); i++)
+  {
+    if (portBusy[i] > portBusy[bottleneck])
+      bottleneck = (int)i;
+  }
+  printf("Machine Model:             %s\n", name.c_str());
+  printf("Estimated Cycles:          %.0f\n", cycles);
+  printf("Critical Path:             %.0f cycles\n", criticalPath);
+  printf("Busiest Port:              %s (%.0f cycles)\n", ports[bottleneck].c_str(), portBusy[bottleneck]);
+  printf("Instructions per Cycle:    %.2f\n", cycles > 0 ? (instructions + parallelInstructions) / cycles : 0.0);
+}
@@ -0,0 +1,73 @@
+#ifndef MACHINE_MODEL_H_
+#define MACHINE_MODEL_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "logger.h"
+using namespace std;
+
+// Cost of one PP instruction on the modelled core
+struct OpCost {
+  double latency;    // cycles until the result can be used
+  double throughput; // reciprocal throughput, cycles the port stays busy
+  int port;
+};
+
+// Estimates the run time of a kernel from the instructions the Logger sees.
+// Up to width instructions issue per cycle, and an instruction starts once
+// its source registers are ready and it has a slot in the window of
+// in-flight instructions (which retire in order). The estimate is the later
+// of that schedule and the total busy time of the busiest port. The critical
+// path only follows dependencies. Branches (e.g. on _pp_cntbits)
+// are assumed to be predicted, and memory is not tracked, so a vload only
+// depends on its mask. _pp_mask_not/_or/_and return their result by value,
+// so the register they write is unknown here: they wait for their source
+// masks but record no destination, and an instruction using their result
+// treats it as ready. Mask ops are therefore off the dependency graph.
+class MachineModel {
+  private:
+    string name;
+    unordered_map<string, OpCost> costs;
+    OpCost fallback;
+    vector<string> ports;
+    int width;
+    int window;
+    unordered_map<const char *, const OpCost *> byPtr;
+
+    unordered_map<const void *, double> ready; // register -> cycle, scheduled
+    unordered_map<const void *, double> chain; // register -> cycle, dependencies only
+    vector<double> retired; // retire cycle of the last window instructions
+    double lastRetire;
+    vector<double> portBusy;
+    double cycles;
+    double criticalPath;
+    unsigned long long instructions;
+    unsigned long long parallelInstructions; // run on the other cores of parallel sections
+
+    const OpCost &cost(const char * instruction);
+    int portIndex(const string &port);
+
+  public:
+    // Without a model file instructions run one at a time for one cycle each,
+    // so the estimate equals the instruction count
+    MachineModel();
+    // Same costs as other with an empty schedule, e.g. for another core
+    MachineModel(const MachineModel &other);
+    // Read "<opcode> <latency> <throughput> <port>" lines plus "width <n>"
+    // and "window <n>", '#' starts a comment and the opcode "default"
+    // applies to unlisted opcodes
+    bool load(const char * path);
+    // partial: some lanes are masked off, so the old value of dest is read too
+    void issue(const char * instruction, bool partial, const __pp_deps &deps);
+    void reset();
+    // Append a section in which every model in cores ran on its own core:
+    // it starts once the instructions so far have retired and lasts as long
+    // as the slowest core
+    void addParallel(const vector<const MachineModel *> &cores);
+    void printEstimate();
+    double getCycles() { return cycles; }
+    double getCriticalPath() { return criticalPath; }
+};
+
+#endif
@@ -2,8 +2,14 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <math.h>
+#include <string.h>
 #include "logger.h"
+#include "PPintrin.h"
+#include "PPexpr.h"
+#include "machine_model.h"
 #include <sstream>
+#include <chrono>
+#include <type_traits>
 #include "def.h"
 using namespace std;
 
@@ -15,24 +21,57 @@ void absSerial(float *values, float *output, int N);
 void absVector(float *values, float *output, int N);
 void clampedExpSerial(float *values, int *exponents, float *output, int N);
 void clampedExpVector(float *values, int *exponents, float *output, int N);
+long clampedExpVectorBucket(float *values, int *exponents, float *output, int N);
 float arraySumSerial(float *values, int N);
 float arraySumVector(float *values, int N);
+bool clampedExpVectorWidth(int width, float *values, int *exponents, float *output, int N);
+bool clampedExpVectorBucketWidth(int width, float *values, int *exponents, float *output, int N);
+bool arraySumVectorWidth(int width, float *values, int N, float *sum);
 bool verifyResult(float *values, int *exponents, float *output, float *gold, int N);
+int firstMismatch(float *output, float *gold, int N);
+bool usedIntrinsics();
+bool sumMatches(float gold, float sum);
+void widthSweep(float *values, int *exponents, float *output, float *gold, int N, bool useMachine);
+bool bucketSweep(bool useMachine);
+bool threadScaling(float *values, int *exponents, float *output, float *gold, int N, int nThreads, bool printLog,
+                   bool profile, const char *profileOut);
+void reportProfile(bool print, const char *out, const char *kernel);
+bool testIntrinsics();
 
 int main(int argc, char *argv[])
 {
   int N = 16;
   bool printLog = false;
+  long ringSize = 0;
+  const char *tracePath = NULL;
+  bool profile = false;
+  const char *profileOut = NULL;
+  MachineModel machine;
+  bool useMachine = false;
+  bool sweep = false;
+  bool intrinsics = false;
+  bool buckets = false;
+  int nThreads = 0;
 
   // parse commandline options ////////////////////////////////////////////
   int opt;
   static struct option long_options[] = {
       {"size", 1, 0, 's'},
       {"log", 0, 0, 'l'},
+      {"ring", 1, 0, 'r'},
+      {"trace", 1, 0, 't'},
+      {"print-trace", 1, 0, 'p'},
+      {"profile", 0, 0, 'P'},
+      {"profile-out", 1, 0, 'o'},
+      {"machine", 1, 0, 'm'},
+      {"width-sweep", 0, 0, 'w'},
+      {"intrinsics", 0, 0, 'i'},
+      {"bucket-sweep", 0, 0, 'b'},
+      {"threads", 1, 0, 'T'},
       {"help", 0, 0, '?'},
       {0, 0, 0, 0}};
 
-  while ((opt = getopt_long(argc, argv, "s:l?", long_options, NULL)) != EOF)
+  while ((opt = getopt_long(argc, argv, "s:lr:t:p:Po:m:wibT:?", long_options, NULL)) != EOF)
   {
 
     switch (opt)
@@ -48,6 +87,47 @@ int main(int argc, char *argv[])
     case 'l':
       printLog = true;
       break;
+    case 'r':
+      ringSize = atol(optarg);
+      if (ringSize <= 0)
+      {
+        printf("Error: Ring size is set to %ld (<=0).\n", ringSize);
+        return -1;
+      }
+      break;
+    case 't':
+      tracePath = optarg;
+      break;
+    case 'p':
+      return printTrace(optarg) ? 0 : 1;
+    case 'P':
+      profile = true;
+      break;
+    case 'o':
+      profileOut = optarg;
+      break;
+    case 'm':
+      if (!machine.load(optarg))
+        return -1;
+      useMachine = true;
+      break;
+    case 'w':
+      sweep = true;
+      break;
+    case 'i':
+      intrinsics = true;
+      break;
+    case 'b':
+      buckets = true;
+      break;
+    case 'T':
+      nThreads = atoi(optarg);
+      if (nThreads <= 0)
+      {
+        printf("Error: Thread count is set to %d (<=0).\n", nThreads);
+        return -1;
+      }
+      break;
     case '?':
     default:
       usage(argv[0]);
@@ -55,12 +135,79 @@ int main(int argc, char *argv[])
     }
   }
 
-  float *values = new float[N + VECTOR_WIDTH];
-  int *exponents = new int[N + VECTOR_WIDTH];
-  float *output = new float[N + VECTOR_WIDTH];
-  float *gold = new float[N + VECTOR_WIDTH];
+#ifdef PP_NOLOG
+  // NOLOG=1 builds count nothing, so only the results can be checked
+  if (printLog || ringSize > 0 || tracePath || profile || profileOut || useMachine || sweep || intrinsics || buckets)
+  {
+    printf("Error: -l, -r, -t, -P, -o, -m, -w, -i and -b need statistics, rebuild without NOLOG=1\n");
+    return -1;
+  }
+#endif
+
+  // Only keep the per-instruction log when it will be printed or traced
+  if (tracePath)
+  {
+    if (!PPLogger.setStream(tracePath))
+    {
+      printf("Error: cannot create trace file %s\n", tracePath);
+      return -1;
+    }
+  }
+  else if (ringSize > 0)
+    PPLogger.setRing(ringSize);
+  else if (!printLog)
+    PPLogger.setStatsOnly();
+  PPLogger.setProfile(profile || profileOut);
+  if (useMachine)
+    PPLogger.setMachineModel(&machine);
+
+  if (intrinsics)
+  {
+    bool passed = testIntrinsics();
+    PPLogger.closeStream();
+    PPLogger.setMachineModel(NULL);
+    return passed ? 0 : 1;
+  }
+
+  if (buckets)
+  {
+    bool passed = bucketSweep(useMachine);
+    PPLogger.closeStream();
+    PPLogger.setMachineModel(NULL);
+    return passed ? 0 : 1;
+  }
+
+  // Padded for the widest vector, so firstMismatch() catches writes past N
+  float *values = new float[N + MAX_VECTOR_WIDTH];
+  int *exponents = new int[N + MAX_VECTOR_WIDTH];
+  float *output = new float[N + MAX_VECTOR_WIDTH];
+  float *gold = new float[N + MAX_VECTOR_WIDTH];
   initValue(values, exponents, output, gold, N);
 
+  if (nThreads > 0)
+  {
+    bool passed = threadScaling(values, exponents, output, gold, N, nThreads, printLog, profile, profileOut);
+    PPLogger.closeStream();
+    PPLogger.setMachineModel(NULL);
+    delete[] values;
+    delete[] exponents;
+    delete[] output;
+    delete[] gold;
+    return passed ? 0 : 1;
+  }
+
+  if (sweep)
+  {
+    widthSweep(values, exponents, output, gold, N, useMachine);
+    PPLogger.closeStream();
+    PPLogger.setMachineModel(NULL);
+    delete[] values;
+    delete[] exponents;
+    delete[] output;
+    delete[] gold;
+    return 0;
+  }
+
   clampedExpSerial(values, exponents, gold, N);
   clampedExpVector(values, exponents, output, N);
 
@@ -72,13 +219,14 @@ int main(int argc, char *argv[])
   if (printLog)
     PPLogger.printLog();
   PPLogger.printStats();
+  reportProfile(profile, profileOut, "clampedexp");
 
   printf("************************ Result Verification *************************\n");
   if (!clampedCorrect)
   {
     printf("@@@ ClampedExp Failed!!!\n");
   }
-  else if (PPLogger.getTotalInstrs() == 0)
+  else if (!usedIntrinsics())
   {
     printf("Not using fake intrinsics in ClampedExp\n");
   }
@@ -87,41 +235,79 @@ int main(int argc, char *argv[])
     printf("ClampedExp Passed!!!\n");
   }
 
+  // Same test with the exponent-bucketed kernel, whose groups run over the
+  // elements sorted by exponent
+#ifndef PP_NOLOG
+  Statistics batchStats = PPLogger.getStats();
+  double batchCycles = PPLogger.getCycles();
+#endif
   PPLogger.refresh();
+  for (int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
+    output[i] = 0.f;
+  long sortSteps = clampedExpVectorBucket(values, exponents, output, N);
 
-  printf("\n\e[1;31mARRAY SUM\e[0m (bonus) \n");
-  if (N % VECTOR_WIDTH == 0)
+  printf("\n\e[1;31mCLAMPED EXPONENT\e[0m (bucketed) \n");
+  bool bucketCorrect = verifyResult(values, exponents, output, gold, N);
+  if (printLog)
+    PPLogger.printLog();
+  PPLogger.printStats();
+  reportProfile(profile, profileOut, "clampedexp-bucket");
+
+  printf("************************ Result Verification *************************\n");
+  if (!bucketCorrect)
+  {
+    printf("@@@ ClampedExp (bucketed) Failed!!!\n");
+  }
+  else
   {
-    float sumGold = arraySumSerial(values, N);
-    float sumOutput = arraySumVector(values, N);
+#ifdef PP_NOLOG
+    (void)sortSteps;
+    printf("ClampedExp (bucketed) Passed!!!\n");
+#else
+    // The counting sort runs in scalar code, so its steps are shown next to
+    // the vector instructions
+    Statistics bucketStats = PPLogger.getStats();
+    printf("ClampedExp (bucketed) Passed!!! Utilization %.1f%% -> %.1f%%, instructions %llu -> %llu + %ld sort steps",
+           (double)batchStats.utilized_lane / batchStats.total_lane * 100,
+           (double)bucketStats.utilized_lane / bucketStats.total_lane * 100, batchStats.total_instructions,
+           bucketStats.total_instructions, sortSteps);
+    if (useMachine)
+      printf(", cycles %.0f -> %.0f", batchCycles, PPLogger.getCycles());
+    printf("\n");
+#endif
+  }
 
-    if (printLog)
-      PPLogger.printLog();
-    PPLogger.printStats();
+  PPLogger.refresh();
 
-    printf("************************ Result Verification *************************\n");
+  printf("\n\e[1;31mARRAY SUM\e[0m (bonus) \n");
+  float sumGold = arraySumSerial(values, N);
+  float sumOutput = arraySumVector(values, N);
 
-    float epsilon = 0.1;
-    bool sumCorrect = abs(sumGold - sumOutput) < epsilon * 2;
-    if (!sumCorrect)
-    {
-      printf("Expected %f, got %f\n.", sumGold, sumOutput);
-      printf("@@@ ArraySum Failed!!!\n");
-    }
-    else if (PPLogger.getTotalInstrs() == 0)
-    {
-      printf("Not using fake intrinsics in ArraySum\n");
-    }
-    else
-    {
-      printf("ArraySum Passed!!!\n");
-    }
+  if (printLog)
+    PPLogger.printLog();
+  PPLogger.printStats();
+  reportProfile(profile, profileOut, "arraysum");
+
+  printf("************************ Result Verification *************************\n");
+
+  bool sumCorrect = sumMatches(sumGold, sumOutput);
+  if (!sumCorrect)
+  {
+    printf("Expected %f, got %f\n.", sumGold, sumOutput);
+    printf("@@@ ArraySum Failed!!!\n");
+  }
+  else if (!usedIntrinsics())
+  {
+    printf("Not using fake intrinsics in ArraySum\n");
   }
   else
   {
-    printf("Must have N %% VECTOR_WIDTH == 0 for this problem (VECTOR_WIDTH is %d)\n", VECTOR_WIDTH);
+    printf("ArraySum Passed!!!\n");
   }
 
+  PPLogger.closeStream();
+  PPLogger.setMachineModel(NULL);
+
   delete[] values;
   delete[] exponents;
   delete[] output;
@@ -136,13 +322,763 @@ void usage(const char *progname)
   printf("Program Options:\n");
   printf("  -s  --size <N>     Use workload size N (Default = 16)\n");
   printf("  -l  --log          Print vector unit execution log\n");
+  printf("  -r  --ring <K>     Only keep the last K log entries\n");
+  printf("  -t  --trace <file> Stream the execution log to a binary trace file\n");
+  printf("  -p  --print-trace <file>  Print a trace written by --trace and exit\n");
+  printf("  -P  --profile      Print utilization per opcode and per call site\n");
+  printf("  -o  --profile-out <file>  Export the profile as CSV (or JSON for *.json),\n");
+  printf("                     the kernel name is inserted before the extension\n");
+  printf("  -m  --machine <file>  Estimate cycles with a machine model (see machine.cfg)\n");
+  printf("  -w  --width-sweep  Run the kernels at every width from 2 to %d and\n", MAX_VECTOR_WIDTH);
+  printf("                     print instructions and utilization per width\n");
+  printf("  -i  --intrinsics   Test the reduction/shuffle/fma/min/max/select/gather/scatter\n");
+  printf("                     intrinsics against serial references and exit\n");
+  printf("  -T  --threads <n>  Split N across n threads, each with its own logger, and\n");
+  printf("                     compare with running the same chunks on one thread\n");
+  printf("  -b  --bucket-sweep Compare ClampedExp with its exponent-bucketed version\n");
+  printf("                     for N = 16 to 10^6, counting the sort pre-pass, and exit\n");
   printf("  -?  --help         This message\n");
 }
 
+// Print and/or export the profile of the kernel that just ran, out = "hot.csv"
+// becomes "hot.<kernel>.csv"
+void reportProfile(bool print, const char *out, const char *kernel)
+{
+  if (print)
+    PPLogger.printProfile();
+  if (!out)
+    return;
+
+  string path(out);
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of('/');
+  if (dot == string::npos || (slash != string::npos && dot < slash))
+    dot = path.size();
+  path.insert(dot, string(".") + kernel);
+  if (!PPLogger.writeProfile(path.c_str()))
+    printf("Error: cannot write profile %s\n", path.c_str());
+}
+
+// Run the kernels at every power-of-two width and print how the instruction
+// count and the vector utilization change with the width. The bucketed
+// kernel's scalar sort does not depend on the width and is left out (see -b).
+void widthSweep(float *values, int *exponents, float *output, float *gold, int N, bool useMachine)
+{
+  clampedExpSerial(values, exponents, gold, N);
+  float sumGold = arraySumSerial(values, N);
+
+  printf("******************* Vector Width Sweep (N = %d) ********************\n", N);
+  printf(" Width |     ClampedExp Instrs  Util. |       Bucketed Instrs  Util. |       ArraySum Instrs  Util. |%s\n",
+         useMachine ? " Cycles (Exp / Bucket / Sum)" : "");
+  printf("------- ------------------------------ ------------------------------ ------------------------------ %s\n",
+         useMachine ? "----------------------------" : "");
+  bool allCorrect = true;
+  for (int width = 2; width <= MAX_VECTOR_WIDTH; width *= 2)
+  {
+    for (int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
+      output[i] = 0.f;
+    PPLogger.refresh();
+    clampedExpVectorWidth(width, values, exponents, output, N);
+    bool expCorrect = firstMismatch(output, gold, N) == -1;
+    Statistics expStats = PPLogger.getStats();
+    double expCycles = PPLogger.getCycles();
+
+    for (int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
+      output[i] = 0.f;
+    PPLogger.refresh();
+    clampedExpVectorBucketWidth(width, values, exponents, output, N);
+    bool bucketCorrect = firstMismatch(output, gold, N) == -1;
+    Statistics bucketStats = PPLogger.getStats();
+    double bucketCycles = PPLogger.getCycles();
+
+    PPLogger.refresh();
+    float sum = 0.f;
+    bool sumRun = arraySumVectorWidth(width, values, N, &sum);
+    bool sumCorrect = !sumRun || sumMatches(sumGold, sum);
+    Statistics sumStats = PPLogger.getStats();
+    double sumCycles = PPLogger.getCycles();
+    allCorrect = allCorrect && expCorrect && bucketCorrect && sumCorrect;
+
+    printf(" %5d | %20llu %5.1f%% %s|", width, expStats.total_instructions,
+           (double)expStats.utilized_lane / expStats.total_lane * 100, expCorrect ? " " : "!");
+    printf(" %20llu %5.1f%% %s|", bucketStats.total_instructions,
+           (double)bucketStats.utilized_lane / bucketStats.total_lane * 100, bucketCorrect ? " " : "!");
+    if (sumRun)
+      printf(" %20llu %5.1f%% %s|", sumStats.total_instructions,
+             (double)sumStats.utilized_lane / sumStats.total_lane * 100, sumCorrect ? " " : "!");
+    else
+      printf(" %20s %6s  |", "-", "-");
+    if (useMachine)
+    {
+      if (sumRun)
+        printf(" %8.0f / %8.0f / %-8.0f", expCycles, bucketCycles, sumCycles);
+      else
+        printf(" %8.0f / %8.0f / %-8s", expCycles, bucketCycles, "-");
+    }
+    printf("\n");
+  }
+  PPLogger.refresh();
+
+  printf("************************ Result Verification *************************\n");
+  if (allCorrect)
+    printf("All widths Passed!!!\n");
+  else
+    printf("@@@ Widths marked '!' Failed!!!\n");
+}
+
+// Run ClampedExp and its exponent-bucketed version over a range of N. The
+// counting sort of the bucketed version runs in scalar code, so each of its
+// steps is counted as one instruction in the end-to-end total.
+bool bucketSweep(bool useMachine)
+{
+  static const int sizes[] = {16, 100, 1000, 10000, 100000, 1000000};
+
+  printf("************** Exponent Buckets (VECTOR_WIDTH = %d) ***************\n", VECTOR_WIDTH);
+  printf("       N |   ClampedExp Instrs  Util. |     Bucketed Instrs  Util. |   Sort Steps |  Total Instrs  Ratio |%s\n",
+         useMachine ? " Cycles (Exp / Bucketed)" : "");
+  printf("--------- ---------------------------- ---------------------------- -------------- ---------------------- %s\n",
+         useMachine ? "------------------------" : "");
+  bool allCorrect = true;
+  for (int N : sizes)
+  {
+    float *values = new float[N + MAX_VECTOR_WIDTH];
+    int *exponents = new int[N + MAX_VECTOR_WIDTH];
+    float *output = new float[N + MAX_VECTOR_WIDTH];
+    float *gold = new float[N + MAX_VECTOR_WIDTH];
+    initValue(values, exponents, output, gold, N);
+    clampedExpSerial(values, exponents, gold, N);
+
+    PPLogger.refresh();
+    clampedExpVector(values, exponents, output, N);
+    bool expCorrect = firstMismatch(output, gold, N) == -1;
+    Statistics expStats = PPLogger.getStats();
+    double expCycles = PPLogger.getCycles();
+
+    for (int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
+      output[i] = 0.f;
+    PPLogger.refresh();
+    long sortSteps = clampedExpVectorBucket(values, exponents, output, N);
+    bool bucketCorrect = firstMismatch(output, gold, N) == -1;
+    Statistics bucketStats = PPLogger.getStats();
+    double bucketCycles = PPLogger.getCycles();
+    allCorrect = allCorrect && expCorrect && bucketCorrect;
+
+    unsigned long long total = bucketStats.total_instructions + sortSteps;
+    printf(" %7d | %18llu %5.1f%% %s| %18llu %5.1f%% %s| %12ld | %13llu %5.2f |", N,
+           expStats.total_instructions, (double)expStats.utilized_lane / expStats.total_lane * 100,
+           expCorrect ? " " : "!", bucketStats.total_instructions,
+           (double)bucketStats.utilized_lane / bucketStats.total_lane * 100, bucketCorrect ? " " : "!",
+           sortSteps, total, (double)total / expStats.total_instructions);
+    if (useMachine)
+      printf(" %10.0f / %-10.0f", expCycles, bucketCycles);
+    printf("\n");
+
+    delete[] values;
+    delete[] exponents;
+    delete[] output;
+    delete[] gold;
+  }
+  PPLogger.refresh();
+
+  printf("************************ Result Verification *************************\n");
+  if (allCorrect)
+    printf("All sizes Passed!!!\n");
+  else
+    printf("@@@ Sizes marked '!' Failed!!!\n");
+  return allCorrect;
+}
+
+// Split [0, N) into nThreads chunks of whole vectors and call kernel(t, begin,
+// end) for each, either one after another on this thread or each in its own
+// thread with its own logger. Chunks need not line up with the padded native
+// registers: masked stores leave inactive and padding lanes alone, so a
+// thread never writes its neighbour's elements.
+template <typename F>
+double runChunks(int N, int nThreads, bool threaded, F kernel)
+{
+  auto start = chrono::steady_clock::now();
+  int groups = (N + VECTOR_WIDTH - 1) / VECTOR_WIDTH;
+  vector<thread> workers;
+  for (int t = 0; t < nThreads; t++)
+  {
+    int begin = min(N, (int)((long)groups * t / nThreads) * VECTOR_WIDTH);
+    int end = min(N, (int)((long)groups * (t + 1) / nThreads) * VECTOR_WIDTH);
+    if (!threaded)
+    {
+      kernel(t, begin, end);
+      continue;
+    }
+    Logger *logger = PPLogger.newThreadLogger();
+    workers.emplace_back([=] {
+      Logger::setThreadLogger(logger);
+      kernel(t, begin, end);
+      Logger::setThreadLogger(NULL);
+    });
+  }
+  for (thread &worker : workers)
+    worker.join();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+#ifndef PP_NOLOG
+static bool sameStats(const Statistics &a, const Statistics &b)
+{
+  return a.total_instructions == b.total_instructions && a.utilized_lane == b.utilized_lane &&
+         a.total_lane == b.total_lane;
+}
+#endif
+
+// Run both kernels split across nThreads threads. The merged statistics
+// must equal those of the same chunks run on one thread.
+bool threadScaling(float *values, int *exponents, float *output, float *gold, int N, int nThreads, bool printLog,
+                   bool profile, const char *profileOut)
+{
+  auto clampedExp = [&](int t, int begin, int end) {
+    clampedExpVector(values + begin, exponents + begin, output + begin, end - begin);
+  };
+  vector<float> partial(nThreads);
+  auto arraySum = [&](int t, int begin, int end) { partial[t] = arraySumVector(values + begin, end - begin); };
+
+  clampedExpSerial(values, exponents, gold, N);
+  float sumGold = arraySumSerial(values, N);
+  bool passed = true;
+  for (int kernel = 0; kernel < 2; kernel++)
+  {
+    printf("%s\e[1;31m%s\e[0m (%d threads) \n", kernel ? "\n" : "", kernel ? "ARRAY SUM" : "CLAMPED EXPONENT",
+           nThreads);
+    float sums[2];
+    Statistics stats[2];
+    double ms[2];
+    for (int threaded = 0; threaded < 2; threaded++)
+    {
+      for (int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
+        output[i] = 0.f;
+      PPLogger.refresh();
+      if (kernel == 0)
+        ms[threaded] = runChunks(N, nThreads, threaded, clampedExp);
+      else
+        ms[threaded] = runChunks(N, nThreads, threaded, arraySum);
+      sums[threaded] = 0.f;
+      for (int t = 0; t < nThreads; t++)
+        sums[threaded] += partial[t];
+      stats[threaded] = PPLogger.getStats();
+    }
+    if (printLog)
+      PPLogger.printLog();
+    PPLogger.printStats();
+    reportProfile(profile, profileOut, kernel ? "arraysum-threads" : "clampedexp-threads");
+
+    printf("************************ Result Verification *************************\n");
+    bool correct;
+    if (kernel == 0)
+    {
+      correct = verifyResult(values, exponents, output, gold, N);
+    }
+    else
+    {
+      // The chunks add up in the same order either way, so the sums match
+      // exactly
+      correct = sums[1] == sums[0] && sumMatches(sumGold, sums[1]);
+      if (!correct)
+        printf("Expected %f, got %f (one thread: %f)\n", sumGold, sums[1], sums[0]);
+    }
+#ifdef PP_NOLOG
+    // Nothing was counted, so there are no statistics to compare
+    bool exact = true;
+    const char *checked = "Results verified, statistics not collected (NOLOG=1)";
+#else
+    bool exact = sameStats(stats[0], stats[1]);
+    const char *checked = "Statistics match the one-thread run";
+#endif
+    if (!exact)
+      printf("One thread: %llu instructions, %llu / %llu lanes\n", stats[0].total_instructions,
+             stats[0].utilized_lane, stats[0].total_lane);
+    printf("Wall time: %.2f ms (one thread: %.2f ms, speedup %.2fx)\n", ms[1], ms[0], ms[0] / ms[1]);
+    if (!correct || !exact)
+      printf("@@@ %s (%d threads) Failed!!!\n", kernel ? "ArraySum" : "ClampedExp", nThreads);
+    else
+      printf("%s (%d threads) Passed!!! %s\n", kernel ? "ArraySum" : "ClampedExp", nThreads, checked);
+    passed = passed && correct && exact;
+  }
+  PPLogger.refresh();
+  return passed;
+}
+
+//*******************
+//* Intrinsic Tests *
+//*******************
+
+// Serial references for the intrinsics checked by --intrinsics. Lane i is
+// active when bit i of mask is set, inactive lanes of out keep their value.
+
+template <typename T>
+T hreduceSerial(T *a, unsigned long long mask, int W)
+{
+  T sum = 0;
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      sum += a[i];
+  }
+  return sum;
+}
+
+template <typename T>
+void permuteSerial(T *out, T *a, int *index, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = a[index[i]];
+  }
+}
+
+template <typename T>
+void broadcastSerial(T *out, T *a, int lane, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = a[lane];
+  }
+}
+
+void fmaSerial(float *out, float *a, float *b, float *c, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = a[i] * b[i] + c[i];
+  }
+}
+
+template <typename T>
+void minMaxSerial(T *out, T *a, T *b, bool max, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = (max ? a[i] > b[i] : a[i] < b[i]) ? a[i] : b[i];
+  }
+}
+
+template <typename T>
+void selectSerial(T *out, T *a, T *b, unsigned long long sel, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = ((sel >> i) & 1) ? a[i] : b[i];
+  }
+}
+
+template <typename T>
+void gatherSerial(T *out, T *base, int *index, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = base[index[i]];
+  }
+}
+
+template <typename T>
+void scatterSerial(T *base, int *index, T *a, unsigned long long mask, int W)
+{
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      base[index[i]] = a[i];
+  }
+}
+
+template <typename T>
+int compressSerial(T *out, T *a, unsigned long long mask, int W)
+{
+  int count = 0;
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[count++] = a[i];
+  }
+  return count;
+}
+
+template <typename T>
+int expandSerial(T *out, T *src, unsigned long long mask, int W)
+{
+  int count = 0;
+  for (int i = 0; i < W; i++)
+  {
+    if ((mask >> i) & 1)
+      out[i] = src[count++];
+  }
+  return count;
+}
+
+// Compare n results, print the test name if they differ
+template <typename T>
+bool checkIntrinsic(const char *name, int W, T *got, T *want, int n, double epsilon)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (abs((double)got[i] - (double)want[i]) > epsilon)
+    {
+      printf("  %-12s failed at width %d, lane %d: expected %g, got %g\n", name, W, i, (double)want[i], (double)got[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Run every intrinsic added on top of the original PPintrin set at width W on
+// random operands and masks, returns the number of failed tests
+template <int W>
+int testIntrinsicsW()
+{
+  __pp_vec<float, W> fa, fb, fc, fr;
+  __pp_vec<int, W> ia, ib, ir, index;
+  __pp_mask_w<W> mask, sel;
+  float fwant[W], fbase[4 * W], fbaseWant[4 * W];
+  int iwant[W], ibase[4 * W], ibaseWant[4 * W];
+  unsigned long long all = ~0ULL >> (64 - W);
+  int failed = 0;
+
+  for (int round = 0; round < 16; round++)
+  {
+    for (int i = 0; i < W; i++)
+    {
+      fa.value[i] = -2.f + 4.f * rand() / RAND_MAX;
+      fb.value[i] = -2.f + 4.f * rand() / RAND_MAX;
+      fc.value[i] = -2.f + 4.f * rand() / RAND_MAX;
+      fr.value[i] = -2.f + 4.f * rand() / RAND_MAX;
+      ia.value[i] = rand() % 200 - 100;
+      ib.value[i] = rand() % 200 - 100;
+      ir.value[i] = rand() % 200 - 100;
+      index.value[i] = rand() % W;
+    }
+    for (int i = 0; i < 4 * W; i++)
+    {
+      fbase[i] = -2.f + 4.f * rand() / RAND_MAX;
+      ibase[i] = rand() % 200 - 100;
+    }
+    mask.bits = (((unsigned long long)rand() << 32) ^ rand()) & all;
+    sel.bits = (((unsigned long long)rand() << 32) ^ rand()) & all;
+    if (round == 0)
+      mask.bits = all;
+
+    float fsum = _pp_hreduce_add_float(fa, mask);
+    float fsumWant = hreduceSerial(fa.value, mask.bits, W);
+    failed += !checkIntrinsic("hreduce", W, &fsum, &fsumWant, 1, 1e-4);
+    int isum = _pp_hreduce_add_int(ia, mask);
+    int isumWant = hreduceSerial(ia.value, mask.bits, W);
+    failed += !checkIntrinsic("hreduce_int", W, &isum, &isumWant, 1, 0);
+
+    memcpy(fwant, fr.value, sizeof(fwant));
+    permuteSerial(fwant, fa.value, index.value, mask.bits, W);
+    _pp_vpermute_float(fr, fa, index, mask);
+    failed += !checkIntrinsic("vpermute", W, fr.value, fwant, W, 0);
+    memcpy(iwant, ir.value, sizeof(iwant));
+    permuteSerial(iwant, ia.value, index.value, mask.bits, W);
+    _pp_vpermute_int(ir, ia, index, mask);
+    failed += !checkIntrinsic("vpermute_int", W, ir.value, iwant, W, 0);
+
+    int lane = rand() % W;
+    memcpy(fwant, fr.value, sizeof(fwant));
+    broadcastSerial(fwant, fb.value, lane, mask.bits, W);
+    _pp_vbroadcast_float(fr, fb, lane, mask);
+    failed += !checkIntrinsic("vbroadcast", W, fr.value, fwant, W, 0);
+    memcpy(iwant, ir.value, sizeof(iwant));
+    broadcastSerial(iwant, ib.value, lane, mask.bits, W);
+    _pp_vbroadcast_int(ir, ib, lane, mask);
+    failed += !checkIntrinsic("vbroadcast_int", W, ir.value, iwant, W, 0);
+
+    // Without hardware FMA the product is rounded once more
+    memcpy(fwant, fr.value, sizeof(fwant));
+    fmaSerial(fwant, fa.value, fb.value, fc.value, mask.bits, W);
+    _pp_vfma_float(fr, fa, fb, fc, mask);
+    failed += !checkIntrinsic("vfma", W, fr.value, fwant, W, 1e-5);
+
+    for (int max = 0; max < 2; max++)
+    {
+      memcpy(fwant, fr.value, sizeof(fwant));
+      minMaxSerial(fwant, fa.value, fb.value, max, mask.bits, W);
+      if (max)
+        _pp_vmax_float(fr, fa, fb, mask);
+      else
+        _pp_vmin_float(fr, fa, fb, mask);
+      failed += !checkIntrinsic(max ? "vmax" : "vmin", W, fr.value, fwant, W, 0);
+      memcpy(iwant, ir.value, sizeof(iwant));
+      minMaxSerial(iwant, ia.value, ib.value, max, mask.bits, W);
+      if (max)
+        _pp_vmax_int(ir, ia, ib, mask);
+      else
+        _pp_vmin_int(ir, ia, ib, mask);
+      failed += !checkIntrinsic(max ? "vmax_int" : "vmin_int", W, ir.value, iwant, W, 0);
+    }
+
+    memcpy(fwant, fr.value, sizeof(fwant));
+    selectSerial(fwant, fa.value, fb.value, sel.bits, mask.bits, W);
+    _pp_vselect_float(fr, fa, fb, sel, mask);
+    failed += !checkIntrinsic("vselect", W, fr.value, fwant, W, 0);
+    memcpy(iwant, ir.value, sizeof(iwant));
+    selectSerial(iwant, ia.value, ib.value, sel.bits, mask.bits, W);
+    _pp_vselect_int(ir, ia, ib, sel, mask);
+    failed += !checkIntrinsic("vselect_int", W, ir.value, iwant, W, 0);
+
+    // Gather and scatter address the whole 4 * W element base array
+    for (int i = 0; i < W; i++)
+      index.value[i] = rand() % (4 * W);
+    memcpy(fwant, fr.value, sizeof(fwant));
+    gatherSerial(fwant, fbase, index.value, mask.bits, W);
+    _pp_vgather_float(fr, fbase, index, mask);
+    failed += !checkIntrinsic("vgather", W, fr.value, fwant, W, 0);
+    memcpy(iwant, ir.value, sizeof(iwant));
+    gatherSerial(iwant, ibase, index.value, mask.bits, W);
+    _pp_vgather_int(ir, ibase, index, mask);
+    failed += !checkIntrinsic("vgather_int", W, ir.value, iwant, W, 0);
+
+    memcpy(fbaseWant, fbase, sizeof(fbase));
+    scatterSerial(fbaseWant, index.value, fa.value, mask.bits, W);
+    _pp_vscatter_float(fbase, index, fa, mask);
+    failed += !checkIntrinsic("vscatter", W, fbase, fbaseWant, 4 * W, 0);
+    memcpy(ibaseWant, ibase, sizeof(ibase));
+    scatterSerial(ibaseWant, index.value, ia.value, mask.bits, W);
+    _pp_vscatter_int(ibase, index, ia, mask);
+    failed += !checkIntrinsic("vscatter_int", W, ibase, ibaseWant, 4 * W, 0);
+
+    // Compress packs the active lanes into the front of the base array and
+    //  expand reads them back
+    memcpy(fbaseWant, fbase, sizeof(fbase));
+    int count = compressSerial(fbaseWant, fa.value, mask.bits, W);
+    int got = _pp_vcompress_float(fbase, fa, mask);
+    failed += !checkIntrinsic("vcompress_count", W, &got, &count, 1, 0);
+    failed += !checkIntrinsic("vcompress", W, fbase, fbaseWant, 4 * W, 0);
+    memcpy(ibaseWant, ibase, sizeof(ibase));
+    count = compressSerial(ibaseWant, ia.value, mask.bits, W);
+    got = _pp_vcompress_int(ibase, ia, mask);
+    failed += !checkIntrinsic("vcompress_int_count", W, &got, &count, 1, 0);
+    failed += !checkIntrinsic("vcompress_int", W, ibase, ibaseWant, 4 * W, 0);
+
+    memcpy(fwant, fr.value, sizeof(fwant));
+    count = expandSerial(fwant, fbase + W, mask.bits, W);
+    got = _pp_vexpand_float(fr, fbase + W, mask);
+    failed += !checkIntrinsic("vexpand_count", W, &got, &count, 1, 0);
+    failed += !checkIntrinsic("vexpand", W, fr.value, fwant, W, 0);
+    memcpy(iwant, ir.value, sizeof(iwant));
+    count = expandSerial(iwant, ibase + W, mask.bits, W);
+    got = _pp_vexpand_int(ir, ibase + W, mask);
+    failed += !checkIntrinsic("vexpand_int_count", W, &got, &count, 1, 0);
+    failed += !checkIntrinsic("vexpand_int", W, ir.value, iwant, W, 0);
+
+    // Fused expressions give the lane results of the unfused chain and log
+    //  one instruction per operation
+    pp::vec<float, W> x(fa), y(fb), z(fc), r(fr);
+    unsigned long long instrs = PPLogger.getTotalInstrs();
+    r.assign(pp::abs(x * y - z) + 1.f, mask);
+    for (int i = 0; i < W; i++)
+      fwant[i] = ((mask.bits >> i) & 1) ? abs(fa.value[i] * fb.value[i] - fc.value[i]) + 1.f : fr.value[i];
+    failed += !checkIntrinsic("expr", W, r.v.value, fwant, W, 1e-5);
+    unsigned long long logged = PPLogger.getTotalInstrs() - instrs, expected = 5;
+    failed += !checkIntrinsic("expr_instrs", W, &logged, &expected, 1, 0);
+
+    memcpy(fbaseWant, fbase, sizeof(fbase));
+    for (int i = 0; i < W; i++)
+    {
+      if ((mask.bits >> i) & 1)
+        fbaseWant[i] = fbase[i] * fa.value[i] < fb.value[i] ? fbase[i] * fa.value[i] : fb.value[i];
+    }
+    instrs = PPLogger.getTotalInstrs();
+    pp::store(fbase, pp::min(pp::load<W>(fbase) * x, y), mask);
+    failed += !checkIntrinsic("expr_store", W, fbase, fbaseWant, 4 * W, 1e-5);
+    logged = PPLogger.getTotalInstrs() - instrs, expected = 4;
+    failed += !checkIntrinsic("expr_store_instrs", W, &logged, &expected, 1, 0);
+
+    pp::vec<int, W> xi(ia), yi(ib), ri(ir);
+    ri.assign(pp::max(xi - yi, yi * 2), mask);
+    for (int i = 0; i < W; i++)
+    {
+      int d = ia.value[i] - ib.value[i], t = ib.value[i] * 2;
+      iwant[i] = ((mask.bits >> i) & 1) ? (d > t ? d : t) : ir.value[i];
+    }
+    failed += !checkIntrinsic("expr_int", W, ri.v.value, iwant, W, 0);
+  }
+  return failed;
+}
+
+// The double, int64, int16 and uint8 functions of one element type, so a
+// single test covers all of them
+template <typename T, typename Acc, int W>
+struct TypedIntrinsics
+{
+  const char *name;
+  void (*vset)(__pp_vec<T, W> &, T, __pp_mask_w<W> &, __pp_site);
+  void (*vmove)(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+  void (*vload)(__pp_vec<T, W> &, T *, __pp_mask_w<W> &, __pp_site);
+  void (*vstore)(T *, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+  void (*vabs)(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+  // add, sub, mult, div, min, max
+  void (*binary[6])(__pp_vec<T, W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+  // gt, lt, eq
+  void (*compare[3])(__pp_mask_w<W> &, __pp_vec<T, W> &, __pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+  Acc (*hreduce)(__pp_vec<T, W> &, __pp_mask_w<W> &, __pp_site);
+};
+
+#define PP_TYPED_INTRINSICS(NAME, W)                                                                \
+  {                                                                                                 \
+    #NAME, _pp_vset_##NAME<W>, _pp_vmove_##NAME<W>, _pp_vload_##NAME<W>, _pp_vstore_##NAME<W>,     \
+        _pp_vabs_##NAME<W>,                                                                         \
+        {_pp_vadd_##NAME<W>, _pp_vsub_##NAME<W>, _pp_vmult_##NAME<W>, _pp_vdiv_##NAME<W>,           \
+         _pp_vmin_##NAME<W>, _pp_vmax_##NAME<W>},                                                   \
+        {_pp_vgt_##NAME<W>, _pp_vlt_##NAME<W>, _pp_veq_##NAME<W>}, _pp_hreduce_add_##NAME<W>        \
+  }
+
+template <typename T>
+T binarySerial(int op, T a, T b)
+{
+  switch (op)
+  {
+  case 0: return a + b;
+  case 1: return a - b;
+  case 2: return a * b;
+  case 3: return a / b;
+  case 4: return a < b ? a : b;
+  default: return a > b ? a : b;
+  }
+}
+
+template <typename T>
+bool compareSerial(int op, T a, T b)
+{
+  return op == 0 ? a > b : op == 1 ? a < b : a == b;
+}
+
+// Run the functions of one element type at W lanes on random operands and
+// masks, and check that every instruction is counted at sizeof(T) bytes.
+// Returns the number of failed tests.
+template <typename T, typename Acc, int W>
+int testTypeW(const TypedIntrinsics<T, Acc, W> &f)
+{
+  static const char *binaryName[6] = {"vadd", "vsub", "vmult", "vdiv", "vmin", "vmax"};
+  static const char *compareName[3] = {"vgt", "vlt", "veq"};
+  __pp_vec<T, W> va, vb, vr;
+  __pp_mask_w<W> mask, result;
+  T a[W], b[W], want[W], mem[W];
+  unsigned long long all = ~0ULL >> (64 - W);
+  int failed = 0;
+  char name[32];
+
+  Statistics before = PPLogger.getElementStats(sizeof(T));
+  unsigned long long issued = 0;
+  for (int round = 0; round < 8; round++)
+  {
+    // Every other round compares equal operands, divisors are never 0
+    for (int i = 0; i < W; i++)
+    {
+      a[i] = (T)(is_signed<T>::value ? rand() % 200 - 100 : rand() % 100);
+      if (is_floating_point<T>::value)
+        a[i] /= 8;
+      b[i] = (round % 2) && a[i] != 0 ? a[i] : (T)(rand() % 10 + 1);
+    }
+    mask.bits = (((unsigned long long)rand() << 32) ^ rand()) & all;
+    if (round == 0)
+      mask.bits = all;
+    __pp_mask_w<W> maskAll = _pp_init_ones<W>();
+
+    f.vload(va, a, maskAll, __pp_site());
+    f.vset(vb, (T)1, maskAll, __pp_site());
+    f.vmove(vb, va, mask, __pp_site());
+    for (int i = 0; i < W; i++)
+      want[i] = ((mask.bits >> i) & 1) ? a[i] : (T)1;
+    snprintf(name, sizeof(name), "vmove_%s", f.name);
+    failed += !checkIntrinsic(name, W, vb.value, want, W, 0);
+    f.vload(vb, b, maskAll, __pp_site());
+    issued += 4;
+
+    for (int op = 0; op < 6; op++)
+    {
+      f.vset(vr, (T)7, maskAll, __pp_site());
+      f.binary[op](vr, va, vb, mask, __pp_site());
+      for (int i = 0; i < W; i++)
+        want[i] = ((mask.bits >> i) & 1) ? binarySerial(op, a[i], b[i]) : (T)7;
+      snprintf(name, sizeof(name), "%s_%s", binaryName[op], f.name);
+      failed += !checkIntrinsic(name, W, vr.value, want, W, 0);
+      issued += 2;
+    }
+
+    f.vabs(vr, va, mask, __pp_site());
+    memcpy(mem, b, sizeof(mem));
+    f.vstore(mem, vr, mask, __pp_site());
+    for (int i = 0; i < W; i++)
+      want[i] = ((mask.bits >> i) & 1) ? (T)(a[i] < 0 ? -a[i] : a[i]) : b[i];
+    snprintf(name, sizeof(name), "vabs_%s", f.name);
+    failed += !checkIntrinsic(name, W, mem, want, W, 0);
+    issued += 2;
+
+    for (int op = 0; op < 3; op++)
+    {
+      result = _pp_init_ones<W>(0);
+      f.compare[op](result, va, vb, mask, __pp_site());
+      unsigned long long got = result.bits, expected = 0;
+      for (int i = 0; i < W; i++)
+        expected |= (unsigned long long)(((mask.bits >> i) & 1) && compareSerial(op, a[i], b[i])) << i;
+      snprintf(name, sizeof(name), "%s_%s", compareName[op], f.name);
+      failed += !checkIntrinsic(name, W, &got, &expected, 1, 0);
+      issued++;
+    }
+
+    Acc sum = f.hreduce(va, mask, __pp_site()), sumWant = 0;
+    for (int i = 0; i < W; i++)
+      sumWant += ((mask.bits >> i) & 1) ? (Acc)a[i] : 0;
+    snprintf(name, sizeof(name), "hreduce_%s", f.name);
+    failed += !checkIntrinsic(name, W, &sum, &sumWant, 1, 1e-9);
+    issued++;
+  }
+
+  Statistics after = PPLogger.getElementStats(sizeof(T));
+  unsigned long long counted = after.total_instructions - before.total_instructions;
+  unsigned long long lanes = after.total_lane - before.total_lane, lanesWant = issued * W;
+  snprintf(name, sizeof(name), "stats_%s", f.name);
+  failed += !checkIntrinsic(name, W, &counted, &issued, 1, 0);
+  failed += !checkIntrinsic(name, W, &lanes, &lanesWant, 1, 0);
+  return failed;
+}
+
+// Test the double, int64, int16 and uint8 functions at the lane counts of a
+// register of W 32-bit lanes
+template <int W>
+int testTypesW()
+{
+  TypedIntrinsics<double, double, __pp_lanes_of<double, W>> d = PP_TYPED_INTRINSICS(double, (__pp_lanes_of<double, W>));
+  TypedIntrinsics<long long, long long, __pp_lanes_of<long long, W>> i64 = PP_TYPED_INTRINSICS(int64, (__pp_lanes_of<long long, W>));
+  TypedIntrinsics<short, int, __pp_lanes_of<short, W>> i16 = PP_TYPED_INTRINSICS(int16, (__pp_lanes_of<short, W>));
+  TypedIntrinsics<unsigned char, int, __pp_lanes_of<unsigned char, W>> u8 = PP_TYPED_INTRINSICS(uint8, (__pp_lanes_of<unsigned char, W>));
+  return testTypeW(d) + testTypeW(i64) + testTypeW(i16) + testTypeW(u8);
+}
+
+#undef PP_TYPED_INTRINSICS
+
+// Test the intrinsics at every width they are instantiated for
+bool testIntrinsics()
+{
+  printf("*************************** Intrinsic Tests ***************************\n");
+  int failed = 0;
+#define PP_TEST_WIDTH(W) failed += testIntrinsicsW<W>() + testTypesW<W>();
+  PP_FOR_EACH_WIDTH(PP_TEST_WIDTH)
+#undef PP_TEST_WIDTH
+  PPLogger.printStats();
+  printf("************************ Result Verification *************************\n");
+  if (failed)
+    printf("@@@ %d Intrinsic Tests Failed!!!\n", failed);
+  else
+    printf("Intrinsics Passed!!!\n");
+  return failed == 0;
+}
+
 void initValue(float *values, int *exponents, float *output, float *gold, unsigned int N)
 {
 
-  for (unsigned int i = 0; i < N + VECTOR_WIDTH; i++)
+  for (unsigned int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
   {
     // random input values
     values[i] = -1.f + 4.f * static_cast<float>(rand()) / RAND_MAX;
@@ -152,18 +1088,39 @@ void initValue(float *values, int *exponents, float *output, float *gold, unsign
   }
 }
 
-bool verifyResult(float *values, int *exponents, float *output, float *gold, int N)
+// Whether the kernel that just ran went through the PP intrinsics; NOLOG=1
+// builds cannot tell
+bool usedIntrinsics()
+{
+#ifdef PP_NOLOG
+  return true;
+#else
+  return PPLogger.getTotalInstrs() > 0;
+#endif
+}
+
+// Vector sums add in another order than the serial one, and the rounding
+// difference grows with N, so the tolerance is relative past small sums
+bool sumMatches(float gold, float sum)
+{
+  return abs(gold - sum) <= max(0.2f, 1e-4f * abs(gold));
+}
+
+// Index of the first wrong output, including writes past N, or -1
+int firstMismatch(float *output, float *gold, int N)
 {
-  int incorrect = -1;
   float epsilon = 0.00001;
-  for (int i = 0; i < N + VECTOR_WIDTH; i++)
+  for (int i = 0; i < N + MAX_VECTOR_WIDTH; i++)
   {
     if (abs(output[i] - gold[i]) > epsilon)
-    {
-      incorrect = i;
-      break;
-    }
+      return i;
   }
+  return -1;
+}
+
+bool verifyResult(float *values, int *exponents, float *output, float *gold, int N)
+{
+  int incorrect = firstMismatch(output, gold, N);
 
   if (incorrect != -1)
   {
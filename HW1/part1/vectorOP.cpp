@@ -6,17 +6,12 @@ void absVector(float *values, float *output, int N)
   __pp_vec_float x;
   __pp_vec_float result;
   __pp_vec_float zero = _pp_vset_float(0.f);
-  __pp_mask maskAll, maskIsNegative, maskIsNotNegative;
+  __pp_mask maskIsNegative, maskIsNotNegative;
 
-  //  Note: Take a careful look at this loop indexing.  This example
-  //  code is not guaranteed to work when (N % VECTOR_WIDTH) != 0.
-  //  Why is that the case?
-  for (int i = 0; i < N; i += VECTOR_WIDTH)
+  // pp_for_each_vector hands out full groups of VECTOR_WIDTH elements and a
+  // masked tail group, so any N works
+  pp_for_each_vector(N, [&](int i, __pp_mask &maskAll)
   {
-
-    // All ones
-    maskAll = _pp_init_ones();
-
     // All zeros
     maskIsNegative = _pp_init_ones(0);
 
@@ -29,46 +24,43 @@ void absVector(float *values, float *output, int N)
     // Execute instruction using mask ("if" clause)
     _pp_vsub_float(result, zero, x, maskIsNegative); //   output[i] = -x;
 
-    // Inverse maskIsNegative to generate "else" mask
+    // Inverse maskIsNegative to generate "else" mask, limited to the group
     maskIsNotNegative = _pp_mask_not(maskIsNegative); // } else {
+    maskIsNotNegative = _pp_mask_and(maskIsNotNegative, maskAll);
 
     // Execute instruction ("else" clause)
     _pp_vload_float(result, values + i, maskIsNotNegative); //   output[i] = x; }
 
     // Write results back to memory
     _pp_vstore_float(output + i, result, maskAll);
-  }
+  });
 }
 
 
-void clampedExpVector(float* values, int* exponents, float* output, int N)
+// Templated on the vector width W so one binary can run it at every width
+template <int W>
+void clampedExpVectorW(float* values, int* exponents, float* output, int N)
 {
-    __pp_vec_float vLimit = _pp_vset_float(9.999999f);
-    __pp_vec_float vOneF  = _pp_vset_float(1.0f);
-    __pp_vec_int   vZeroI = _pp_vset_int(0);
-    __pp_vec_int   vOneI  = _pp_vset_int(1);
-
-    for (int i = 0; i < N; i += VECTOR_WIDTH) {
-        // 1) 建立這一批有效 lane 的 active mask（處理尾端不足一組）
-        int remain = N - i;
-        __pp_mask mAll = (remain >= VECTOR_WIDTH)
-                       ? _pp_init_ones()        // 如果剩餘的元素數量 >= 向量寬度，mask 全部是 1
-                       : _pp_init_ones(remain); // 否則只開啟前 "remain" 個有效 lane
+    __pp_vec<float, W> vLimit = _pp_vset_float<W>(9.999999f);
+    __pp_vec<float, W> vOneF  = _pp_vset_float<W>(1.0f);
+    __pp_vec<int, W>   vZeroI = _pp_vset_int<W>(0);
+    __pp_vec<int, W>   vOneI  = _pp_vset_int<W>(1);
+
+    __pp_vec<float, W> vX, vRes;
+    __pp_vec<int, W>   vY, vCnt;
 
+    // 1) pp_for_each_vector 給出每一批的 active mask（尾端不足一組時只開啟前 N % W 個 lane）
+    pp_for_each_vector<W>(N, [&](int i, __pp_mask_w<W> &mAll) {
         // 2) 向量載入 values 和 exponents
-        __pp_vec_float vX;
-        __pp_vec_int   vY;
         _pp_vload_float(vX, values + i, mAll);    // 只載入有效 lane
         _pp_vload_int  (vY, exponents + i, mAll); // 只載入有效 lane
 
         // 3) 冪次初始化：res = 1；cnt = exponent
-        __pp_vec_float vRes;
-        __pp_vec_int   vCnt;
         _pp_vset_float(vRes, 1.0f, mAll);     // 只在有效 lane 設為 1.0
         _pp_vmove_int (vCnt, vY, mAll);       // 將 exponent 複製給每個 lane
 
         // 4) while (cnt > 0) { res *= x; cnt--; } 以 mask 控制仍需運算的 lane
-        __pp_mask mCntPos;
+        __pp_mask_w<W> mCntPos;
         _pp_vgt_int(mCntPos, vCnt, vZeroI, mAll);  // mCntPos = (cnt > 0) & mAll，檢查每個 lane 是否還需要運算
         while (_pp_cntbits(mCntPos) > 0) {
             // 只對那些需要運算的 lane 做乘法：res *= x
@@ -79,64 +71,169 @@ void clampedExpVector(float* values, int* exponents, float* output, int N)
             _pp_vgt_int(mCntPos, vCnt, vZeroI, mAll); // 重新判斷哪些 lane 的 cnt > 0
         }
 
-        // 5) clamp：如果 res > 9.999999，將其設為 9.999999（只在超過的 lane 進行）
-        __pp_mask mClamp;
-        _pp_vgt_float(mClamp, vRes, vLimit, mAll);     // 產生超過 9.999999 的 mask
-        _pp_vmove_float(vRes, vLimit, mClamp);          // 將超過的 lane 設為 9.999999
+        // 5) clamp：res = min(res, 9.999999)，一個指令完成比較與搬移
+        _pp_vmin_float(vRes, vRes, vLimit, mAll);
 
         // 6) 存回結果（只將有效的 lane 寫回）
         _pp_vstore_float(output + i, vRes, mAll);
-    }
+    });
 }
 
+void clampedExpVector(float* values, int* exponents, float* output, int N)
+{
+    clampedExpVectorW<VECTOR_WIDTH>(values, exponents, output, N);
+}
 
+// Counting sort of the element indices by exponent: bucket e holds the
+// indices order[start[e]] .. order[start[e + 1] - 1]. Exponents must be in
+// [0, EXP_MAX). Returns the number of scalar steps taken, so callers can
+// report the cost of the pre-pass next to the vector instruction count.
+static long bucketByExponent(int* exponents, int N, int* order, int* start)
+{
+    int count[EXP_MAX] = {0};
+    for (int i = 0; i < N; i++)
+        count[exponents[i]]++;
+    // count[e] becomes the next free slot of bucket e
+    start[0] = 0;
+    for (int e = 0; e < EXP_MAX; e++) {
+        start[e + 1] = start[e] + count[e];
+        count[e] = start[e];
+    }
+    for (int i = 0; i < N; i++)
+        order[count[exponents[i]]++] = i;
+    return 2L * N + EXP_MAX;
+}
 
-// returns the sum of all elements in values
-// You can assume N is a multiple of VECTOR_WIDTH
-// You can assume VECTOR_WIDTH is a power of 2
-// float arraySumVector(float *values, int N)
-// {
+// Bucketed version of clampedExpVectorW: after the counting sort the
+// groups run over the indices in exponent order, so the lanes of a group
+// have close exponents and drop out of the multiply loop in lane order, at
+// the bucket boundaries. Values are gathered through the sorted indices and
+// the results scattered back to output.
+template <int W>
+long clampedExpVectorBucketW(float* values, int* exponents, float* output, int N)
+{
+    int* order = new int[N];
+    int start[EXP_MAX + 1];
+    long sortSteps = bucketByExponent(exponents, N, order, start);
+
+    __pp_vec<float, W> vLimit = _pp_vset_float<W>(9.999999f);
+    __pp_vec<float, W> vX, vRes;
+    __pp_vec<int, W>   vIdx;
+    __pp_mask_w<W> mPow;
+    pp_for_each_vector<W>(N, [&](int i, __pp_mask_w<W> &mask) {
+        // The last group ends at order + N; its masked load reads no index
+        // past that
+        _pp_vload_int(vIdx, order + i, mask);
+        _pp_vgather_float(vX, values, vIdx, mask);
+        // x^0 = 1, otherwise start from x and multiply e - 1 times
+        if (start[1] > i)
+            _pp_vset_float(vRes, 1.0f, mask);
+        // Lane j has an exponent of at least e iff i + j >= start[e]
+        mPow = mask;
+        for (int e = 1; e < EXP_MAX && start[e] < i + W && start[e] < N; e++) {
+            if (start[e] > i && start[e] > start[e - 1]) {
+                mPow = _pp_init_ones<W>(start[e] - i);
+                mPow = _pp_mask_not(mPow);
+                mPow = _pp_mask_and(mPow, mask);
+            }
+            if (e == 1)
+                _pp_vmove_float(vRes, vX, mPow);
+            else
+                _pp_vmult_float(vRes, vRes, vX, mPow);
+        }
+        _pp_vmin_float(vRes, vRes, vLimit, mask);
+        _pp_vscatter_float(output, vIdx, vRes, mask);
+    });
 
-//   //
-//   // PP STUDENTS TODO: Implement your vectorized version of arraySumSerial here
-//   //
+    delete[] order;
+    return sortSteps;
+}
 
-//   for (int i = 0; i < N; i += VECTOR_WIDTH)
-//   {
-//   }
+long clampedExpVectorBucket(float* values, int* exponents, float* output, int N)
+{
+    return clampedExpVectorBucketW<VECTOR_WIDTH>(values, exponents, output, N);
+}
 
-//   return 0.0;
-// }
 
 
-float arraySumVector(float *values, int N)
+// returns the sum of all elements in values, for any N
+// The adds into one accumulator form a dependency chain, so the loop is
+// unrolled over PP_SUM_UNROLL independent partial sums
+#define PP_SUM_UNROLL 4
+
+template <int W>
+float arraySumVectorW(float *values, int N)
 {
-  float totalSum = 0.f;
-  __pp_vec_float currentVals, haddVals, interleavedVals;
-  __pp_mask activeMask;
+  __pp_vec<float, W> currentVals;
+  __pp_vec<float, W> partialSums[PP_SUM_UNROLL];
+  __pp_mask_w<W> activeMask = _pp_init_ones<W>();
+  for (int k = 0; k < PP_SUM_UNROLL; k++)
+    partialSums[k] = _pp_vset_float<W>(0.f);
 
-  for (int i = 0; i < N; i += VECTOR_WIDTH)
+  pp_for_each_vector_unroll<PP_SUM_UNROLL, W>(N, [&](int i, int k, __pp_mask_w<W> &mask)
   {
-      // Initialize mask with all lanes active
-      activeMask = _pp_init_ones();
-
       // Load values from array into vector
-      _pp_vload_float(currentVals, values + i, activeMask);
+      _pp_vload_float(currentVals, values + i, mask);
+
+      // Keep W partial sums per accumulator, one per lane
+      _pp_vadd_float(partialSums[k], partialSums[k], currentVals, mask);
+  });
 
-      // Perform horizontal addition
-      _pp_hadd_float(haddVals, currentVals);
+  // Add up the accumulators, then the lanes, once at the end
+  for (int k = 1; k < PP_SUM_UNROLL; k++)
+    _pp_vadd_float(partialSums[0], partialSums[0], partialSums[k], activeMask);
+  return _pp_hreduce_add_float(partialSums[0], activeMask);
+}
+
+float arraySumVector(float *values, int N)
+{
+  return arraySumVectorW<VECTOR_WIDTH>(values, N);
+}
 
-      // Interleave even and odd lanes
-      _pp_interleave_float(interleavedVals, haddVals);
+// Run the kernels at a width chosen at run time, return false if the
+// intrinsics are not instantiated for that width
+#define PP_WIDTH_CASE(W)                                \
+  case W:                                               \
+    clampedExpVectorW<W>(values, exponents, output, N); \
+    return true;
 
-      // Sum the first half of the interleaved result
-      for (int j = 0; j < VECTOR_WIDTH / 2; j++)
-      {
-          totalSum += interleavedVals.value[j];
-      }
+bool clampedExpVectorWidth(int width, float *values, int *exponents, float *output, int N)
+{
+  switch (width)
+  {
+    PP_FOR_EACH_WIDTH(PP_WIDTH_CASE)
   }
+  return false;
+}
 
-  return totalSum;
+#undef PP_WIDTH_CASE
+#define PP_WIDTH_CASE(W)                                      \
+  case W:                                                     \
+    clampedExpVectorBucketW<W>(values, exponents, output, N); \
+    return true;
+
+bool clampedExpVectorBucketWidth(int width, float *values, int *exponents, float *output, int N)
+{
+  switch (width)
+  {
+    PP_FOR_EACH_WIDTH(PP_WIDTH_CASE)
+  }
+  return false;
 }
 
+#undef PP_WIDTH_CASE
+#define PP_WIDTH_CASE(W)                  \
+  case W:                                 \
+    *sum = arraySumVectorW<W>(values, N); \
+    return true;
+
+bool arraySumVectorWidth(int width, float *values, int N, float *sum)
+{
+  switch (width)
+  {
+    PP_FOR_EACH_WIDTH(PP_WIDTH_CASE)
+  }
+  return false;
+}
 
+#undef PP_WIDTH_CASE
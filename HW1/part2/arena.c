@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+size_t arena_footprint(size_t bytes) {
+  return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+int arena_init(arena_t *arena, size_t size, int huge_pages) {
+  void *base = MAP_FAILED;
+  arena->huge = 0;
+  if (huge_pages) {
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED)
+      arena->huge = 1;
+  }
+  if (base == MAP_FAILED) {
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+      return -1;
+    if (huge_pages && madvise(base, size, MADV_HUGEPAGE) == 0)
+      arena->huge = 2;
+  }
+  arena->base = base;
+  arena->size = size;
+  arena->used = 0;
+  return 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t bytes) {
+  size_t footprint = arena_footprint(bytes);
+  if (footprint > arena->size - arena->used)
+    return NULL;
+  void *p = arena->base + arena->used;
+  arena->used += footprint;
+  return p;
+}
+
+void arena_free(arena_t *arena) {
+  if (arena->base)
+    munmap(arena->base, arena->size);
+  arena->base = NULL;
+  arena->size = arena->used = 0;
+}
+
+typedef struct {
+  void (*fn)(size_t begin, size_t end, void *ctx);
+  void *ctx;
+  size_t begin;
+  size_t end;
+} part_t;
+
+static void *run_part(void *arg) {
+  part_t *part = arg;
+  part->fn(part->begin, part->end, part->ctx);
+  return NULL;
+}
+
+void parallel_for(int threads, size_t n, void (*fn)(size_t begin, size_t end, void *ctx), void *ctx) {
+  if (threads <= 1) {
+    fn(0, n, ctx);
+    return;
+  }
+  pthread_t *ids = malloc(threads * sizeof(pthread_t));
+  part_t *parts = malloc(threads * sizeof(part_t));
+  for (int t = 0; t < threads; t++) {
+    parts[t] = (part_t){fn, ctx, n * t / threads, n * (t + 1) / threads};
+    if (t > 0)
+      pthread_create(&ids[t], NULL, run_part, &parts[t]);
+  }
+  // The calling thread takes the first part
+  run_part(&parts[0]);
+  for (int t = 1; t < threads; t++)
+    pthread_join(ids[t], NULL);
+  free(parts);
+  free(ids);
+}
+
+struct team {
+  int threads;
+  pthread_t *ids;
+  struct member *members;
+  pthread_barrier_t start;
+  pthread_barrier_t done;
+  cpu_set_t caller_cpus;  // restored by team_destroy
+  // The current run, quit ends the threads
+  size_t n;
+  void (*fn)(int member, size_t begin, size_t end, void *ctx);
+  void *ctx;
+  int quit;
+};
+
+struct member {
+  team_t *team;
+  int index;
+  int cpu;
+};
+
+static void pin(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void run_member(struct member *m) {
+  team_t *team = m->team;
+  size_t n = team->n;
+  team->fn(m->index, n * m->index / team->threads, n * (m->index + 1) / team->threads, team->ctx);
+}
+
+static void *member_loop(void *arg) {
+  struct member *m = arg;
+  team_t *team = m->team;
+  pin(m->cpu);
+  for (;;) {
+    pthread_barrier_wait(&team->start);
+    if (team->quit)
+      return NULL;
+    run_member(m);
+    pthread_barrier_wait(&team->done);
+  }
+}
+
+team_t *team_create(int threads) {
+  team_t *team = calloc(1, sizeof(team_t));
+  team->threads = threads;
+  team->ids = malloc(threads * sizeof(pthread_t));
+  team->members = malloc(threads * sizeof(struct member));
+  pthread_barrier_init(&team->start, NULL, threads);
+  pthread_barrier_init(&team->done, NULL, threads);
+
+  // Members take the allowed CPUs in order
+  if (sched_getaffinity(0, sizeof(team->caller_cpus), &team->caller_cpus) != 0) {
+    CPU_ZERO(&team->caller_cpus);
+    CPU_SET(0, &team->caller_cpus);
+  }
+  int cpus = CPU_COUNT(&team->caller_cpus);
+  for (int t = 0, cpu = 0; t < threads; t++, cpu++) {
+    if (t % cpus == 0)
+      cpu = 0;
+    while (!CPU_ISSET(cpu, &team->caller_cpus))
+      cpu++;
+    team->members[t] = (struct member){team, t, cpu};
+  }
+  pin(team->members[0].cpu);
+  for (int t = 1; t < threads; t++)
+    pthread_create(&team->ids[t], NULL, member_loop, &team->members[t]);
+  return team;
+}
+
+void team_run(team_t *team, size_t n, void (*fn)(int member, size_t begin, size_t end, void *ctx), void *ctx) {
+  team->n = n;
+  team->fn = fn;
+  team->ctx = ctx;
+  if (team->threads > 1)
+    pthread_barrier_wait(&team->start);
+  run_member(&team->members[0]);
+  if (team->threads > 1)
+    pthread_barrier_wait(&team->done);
+}
+
+void team_destroy(team_t *team) {
+  team->quit = 1;
+  if (team->threads > 1)
+    pthread_barrier_wait(&team->start);
+  for (int t = 1; t < team->threads; t++)
+    pthread_join(team->ids[t], NULL);
+  sched_setaffinity(0, sizeof(team->caller_cpus), &team->caller_cpus);
+  pthread_barrier_destroy(&team->start);
+  pthread_barrier_destroy(&team->done);
+  free(team->members);
+  free(team->ids);
+  free(team);
+}
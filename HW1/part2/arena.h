@@ -0,0 +1,51 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Allocations are aligned to a cache line, which covers AVX-512 loads
+#define ARENA_ALIGNMENT 64
+
+// A bump allocator over one anonymous mapping. Pages are not touched until
+// first written, so the thread that initializes an array decides where its
+// pages live.
+typedef struct {
+  char *base;
+  size_t size;
+  size_t used;
+  int huge;  // 1 for MAP_HUGETLB pages, 2 for transparent huge pages
+} arena_t;
+
+// Map size bytes, backed by huge pages if huge_pages is set and the system
+// has them (falling back to transparent huge pages, then to normal pages).
+// Returns 0 on success.
+int arena_init(arena_t *arena, size_t size, int huge_pages);
+
+// Return bytes from the arena aligned to ARENA_ALIGNMENT, or NULL when it is
+// full
+void *arena_alloc(arena_t *arena, size_t bytes);
+
+// Bytes arena_alloc takes for an allocation of bytes
+size_t arena_footprint(size_t bytes);
+
+void arena_free(arena_t *arena);
+
+// Call fn(begin, end, ctx) for `threads` equal parts of [0, n), each on its
+// own thread
+void parallel_for(int threads, size_t n, void (*fn)(size_t begin, size_t end, void *ctx), void *ctx);
+
+// A team of threads that stay alive between runs, each pinned to one of the
+// CPUs the process may use (round robin). The calling thread is member 0 and
+// is pinned too until team_destroy().
+typedef struct team team_t;
+
+team_t *team_create(int threads);
+
+// Call fn(member, begin, end, ctx) for the same parts of [0, n) as
+// parallel_for, each on its member. Arrays initialized by a team run are
+// placed on the NUMA nodes of the members that later run over the same parts.
+void team_run(team_t *team, size_t n, void (*fn)(int member, size_t begin, size_t end, void *ctx), void *ctx);
+
+void team_destroy(team_t *team);
+
+#endif
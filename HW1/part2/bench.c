@@ -0,0 +1,275 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "fasttime.h"
+
+// Set by the Makefile to the suffix of the build (".novec", ".vec.avx2", ...)
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT ""
+#endif
+
+const char *const bench_variant = BENCH_VARIANT;
+
+const char *const isa_names[ISA_COUNT] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+int isa_supported(int isa) {
+  __builtin_cpu_init();
+  switch (isa) {
+    case ISA_SCALAR: return 1;
+    case ISA_SSE42: return __builtin_cpu_supports("sse4.2");
+    case ISA_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case ISA_AVX512: return __builtin_cpu_supports("avx512f");
+    default: return 0;
+  }
+}
+
+int isa_best(void) {
+  int isa = ISA_COUNT - 1;
+  while (!isa_supported(isa))
+    isa--;
+  return isa;
+}
+
+int isa_parse(const char *name, int *isa) {
+  if (strcmp(name, "build") == 0) {
+    *isa = ISA_BUILD;
+    return 0;
+  }
+  if (strcmp(name, "best") == 0) {
+    *isa = isa_best();
+    return 0;
+  }
+  for (int i = 0; i < ISA_COUNT; i++) {
+    if (strcmp(name, isa_names[i]) == 0) {
+      *isa = i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+const char *isa_name(int isa) {
+  return isa == ISA_BUILD ? "build" : isa_names[isa];
+}
+
+// Random value in [0, 1) for element i of one of the arrays, a hash of i so
+// that it does not depend on which thread writes it
+static double uniform(unsigned long long array, size_t i) {
+  unsigned long long x = (i * 4 + array + 1) * 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return (x ^ (x >> 31)) * 0x1.0p-64;
+}
+
+void bench_init(size_t begin, size_t end, void *ctx) {
+  bench_data_t *data = ctx;
+  for (size_t i = begin; i < end; i++) {
+    data->a[i] = -1.0f + 4.0f * (float)uniform(0, i);
+    data->b[i] = -1.0f + 4.0f * (float)uniform(1, i);
+    data->d[i] = -1.0 + 4.0 * uniform(2, i);
+    data->c[i] = 0.0f;
+  }
+}
+
+const kernel_t *find_kernel(const char *name) {
+  for (int i = 0; i < num_kernels; i++) {
+    if (strcmp(kernels[i].name, name) == 0)
+      return &kernels[i];
+  }
+  return NULL;
+}
+
+// Seconds per call of `calls` back-to-back calls
+static double sample(void (*run)(bench_data_t *, int), bench_data_t *data, int N, long calls) {
+  fasttime_t start = gettime();
+  for (long i = 0; i < calls; i++)
+    run(data, N);
+  fasttime_t end = gettime();
+  return tdiff(start, end) / calls;
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+bench_result_t bench_run(const kernel_t *kernel, bench_data_t *data, int N, const bench_config_t *config) {
+  bench_result_t result = {kernel, N, config->isa, 1, config->reps, 0, 0, 0, 0, 0, NAN, {0}};
+  void (*run)(bench_data_t *, int) = kernel->run;
+  if (config->isa != ISA_BUILD && kernel->clones[config->isa])
+    run = kernel->clones[config->isa];
+  else
+    result.isa = ISA_BUILD;
+
+  // Double the calls per sample until a sample lasts min_time, these calls
+  // also warm up the caches
+  if (config->min_time > 0) {
+    while (sample(run, data, N, result.calls) * result.calls < config->min_time)
+      result.calls *= 2;
+  }
+  for (int i = 0; i < config->warmup; i++)
+    sample(run, data, N, result.calls);
+
+  // The counters cover all timed samples
+  fastcounters_t counters;
+  int counting = config->counters && fastcounters_open(&counters) > 0;
+  if (counting)
+    fastcounters_start(&counters);
+
+  double *times = malloc(config->reps * sizeof(double));
+  double sum = 0;
+  for (int i = 0; i < config->reps; i++) {
+    times[i] = sample(run, data, N, result.calls);
+    sum += times[i];
+  }
+
+  if (counting)
+    fastcounters_stop(&counters, result.counts);
+  if (config->counters)
+    fastcounters_close(&counters);
+  for (int i = 0; i < FASTCOUNT_COUNT; i++) {
+    if (!counting)
+      result.counts[i] = -1;
+    else if (result.counts[i] >= 0)
+      result.counts[i] /= (double)config->reps * result.calls;
+  }
+  qsort(times, config->reps, sizeof(double), compare_double);
+  int reps = config->reps;
+  result.median = reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+  result.min = times[0];
+  double mean = sum / reps, var = 0;
+  for (int i = 0; i < reps; i++)
+    var += (times[i] - mean) * (times[i] - mean);
+  result.stddev = reps > 1 ? sqrt(var / (reps - 1)) : 0;
+  free(times);
+
+  double elems = (double)N * kernel->passes;
+  result.gflops = kernel->flops_per_elem * elems / result.median * 1e-9;
+  result.gbs = kernel->bytes_per_elem * elems / result.median * 1e-9;
+
+  // Compare the last result of a reduction with a long double sum
+  if (kernel->reduction) {
+    long double ref = 0;
+    for (int j = 0; j < N; j++)
+      ref += data->d[j];
+    ref *= kernel->passes;
+    result.error = ref != 0 ? (double)fabsl((bench_sink - ref) / ref) : fabs(bench_sink);
+  }
+  return result;
+}
+
+void bench_begin(FILE *out, bench_format_t format) {
+  switch (format) {
+    case FORMAT_TABLE:
+      fprintf(out, "%-10s %-12s %-7s %10s %10s %12s %12s %12s %9s %9s %9s\n", "variant", "kernel", "isa", "N",
+              "calls", "median(s)", "min(s)", "stddev(s)", "GFLOP/s", "GB/s", "rel.err");
+      break;
+    case FORMAT_CSV:
+      fprintf(out, "variant,kernel,isa,n,passes,calls,reps,median_s,min_s,stddev_s,gflops,gbs,rel_error\n");
+      break;
+    case FORMAT_JSON:
+      fprintf(out, "[\n");
+      break;
+  }
+}
+
+void bench_report(FILE *out, bench_format_t format, const bench_result_t *r, int first) {
+  // The error column is left empty for kernels that are not reductions
+  char error[32] = "";
+  switch (format) {
+    case FORMAT_TABLE:
+      if (isnan(r->error))
+        strcpy(error, "-");
+      else
+        snprintf(error, sizeof(error), "%.2e", r->error);
+      fprintf(out, "%-10s %-12s %-7s %10d %10ld %12.6g %12.6g %12.3g %9.3f %9.3f %9s\n", bench_variant,
+              r->kernel->name, isa_name(r->isa), r->N, r->calls, r->median, r->min, r->stddev, r->gflops, r->gbs,
+              error);
+      break;
+    case FORMAT_CSV:
+      if (!isnan(r->error))
+        snprintf(error, sizeof(error), "%.6g", r->error);
+      fprintf(out, "%s,%s,%s,%d,%ld,%ld,%d,%.9g,%.9g,%.9g,%.6g,%.6g,%s\n", bench_variant, r->kernel->name,
+              isa_name(r->isa), r->N, r->kernel->passes, r->calls, r->reps, r->median, r->min, r->stddev,
+              r->gflops, r->gbs, error);
+      break;
+    case FORMAT_JSON:
+      if (isnan(r->error))
+        strcpy(error, "null");
+      else
+        snprintf(error, sizeof(error), "%.6g", r->error);
+      fprintf(out,
+              "%s  {\"variant\": \"%s\", \"kernel\": \"%s\", \"isa\": \"%s\", \"n\": %d, \"passes\": %ld, "
+              "\"calls\": %ld, \"reps\": %d, \"median_s\": %.9g, \"min_s\": %.9g, \"stddev_s\": %.9g, "
+              "\"gflops\": %.6g, \"gbs\": %.6g, \"rel_error\": %s}",
+              first ? "" : ",\n", bench_variant, r->kernel->name, isa_name(r->isa), r->N, r->kernel->passes,
+              r->calls, r->reps, r->median, r->min, r->stddev, r->gflops, r->gbs, error);
+      break;
+  }
+}
+
+void bench_end(FILE *out, bench_format_t format) {
+  if (format == FORMAT_JSON)
+    fprintf(out, "\n]\n");
+}
+
+void bench_speedup(FILE *out, const bench_result_t *results, int count) {
+  fprintf(out, "%-12s %10s", "kernel", "N");
+  for (int isa = 0; isa < ISA_COUNT; isa++)
+    fprintf(out, " %19s", isa_names[isa]);
+  fprintf(out, "\n");
+
+  // Results of one kernel and size are consecutive, scalar first
+  for (int i = 0; i < count;) {
+    const bench_result_t *row[ISA_COUNT] = {NULL};
+    int j = i;
+    for (; j < count && results[j].kernel == results[i].kernel && results[j].N == results[i].N; j++) {
+      if (results[j].isa != ISA_BUILD)
+        row[results[j].isa] = &results[j];
+    }
+    if (row[ISA_SCALAR]) {
+      fprintf(out, "%-12s %10d", results[i].kernel->name, results[i].N);
+      for (int isa = 0; isa < ISA_COUNT; isa++) {
+        if (row[isa])
+          fprintf(out, " %9.3g s (%5.2fx)", row[isa]->median, row[ISA_SCALAR]->median / row[isa]->median);
+        else
+          fprintf(out, " %19s", "-");
+      }
+      fprintf(out, "\n");
+    }
+    i = j;
+  }
+}
+
+void bench_counters(FILE *out, const bench_result_t *results, int count) {
+  static const char *const names[FASTCOUNT_COUNT] = {"cycles", "instr", "br.miss", "L1d.miss", "LLC.miss",
+                                                     "fp.scalar", "fp.vector"};
+  fprintf(out, "%-12s %-7s %10s %12s", "kernel", "isa", "N", "median(s)");
+  for (int i = 0; i < FASTCOUNT_COUNT; i++)
+    fprintf(out, " %9s", names[i]);
+  fprintf(out, " %6s %6s\n", "IPC", "vec%");
+
+  // Counts are per element (per element of each pass for the testN kernels)
+  for (int i = 0; i < count; i++) {
+    const bench_result_t *r = &results[i];
+    const double *c = r->counts;
+    double elems = (double)r->N * r->kernel->passes;
+    fprintf(out, "%-12s %-7s %10d %12.6g", r->kernel->name, isa_name(r->isa), r->N, r->median);
+    for (int j = 0; j < FASTCOUNT_COUNT; j++) {
+      if (c[j] >= 0)
+        fprintf(out, " %9.4f", c[j] / elems);
+      else
+        fprintf(out, " %9s", "-");
+    }
+    if (c[FASTCOUNT_CYCLES] > 0 && c[FASTCOUNT_INSTRUCTIONS] >= 0)
+      fprintf(out, " %6.2f", c[FASTCOUNT_INSTRUCTIONS] / c[FASTCOUNT_CYCLES]);
+    else
+      fprintf(out, " %6s", "-");
+    double fp = c[FASTCOUNT_FP_SCALAR] + c[FASTCOUNT_FP_VECTOR];
+    if (c[FASTCOUNT_FP_SCALAR] >= 0 && c[FASTCOUNT_FP_VECTOR] >= 0 && fp > 0)
+      fprintf(out, " %5.1f%%\n", 100 * c[FASTCOUNT_FP_VECTOR] / fp);
+    else
+      fprintf(out, " %6s\n", "-");
+  }
+}
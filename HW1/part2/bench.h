@@ -0,0 +1,132 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include "arena.h"
+#include "fasttime.h"
+
+// Arrays shared by every kernel, each holds at least capacity elements
+typedef struct {
+  float *a;
+  float *b;
+  float *c;
+  double *d;
+  int capacity;
+  int threads;  // for the parallel kernels
+  team_t *team;  // runs them across calls, NULL for one thread
+} bench_data_t;
+
+// Fill elements [begin, end) of the arrays of data (a bench_data_t) with
+// random values that do not depend on which thread writes them
+void bench_init(size_t begin, size_t end, void *data);
+
+// Reductions store their result here, which keeps it alive and lets
+// bench_run() check it. Each thread has its own.
+extern _Thread_local volatile double bench_sink;
+
+// Instruction sets the kernels are cloned for
+typedef enum { ISA_SCALAR, ISA_SSE42, ISA_AVX2, ISA_AVX512, ISA_COUNT } isa_t;
+
+// Run the kernel as compiled with the Makefile flags rather than a clone
+#define ISA_BUILD -1
+
+extern const char *const isa_names[ISA_COUNT];
+
+// Whether the CPU runs isa (cpuid), and the widest one it runs
+int isa_supported(int isa);
+int isa_best(void);
+
+// Parse an ISA name, "build" or "best" into *isa, returns -1 if unknown
+int isa_parse(const char *name, int *isa);
+
+// Name of an ISA, or "build"
+const char *isa_name(int isa);
+
+// The ISA clones keep the scalar loops scalar and ask for vectorization in
+// the others, also in -fno-vectorize builds (which lets clang reorder the
+// sum the way -ffast-math does)
+#if defined(__clang__)
+#define LOOP_SCALAR _Pragma("clang loop vectorize(disable) interleave(disable)")
+#define LOOP_VECTOR _Pragma("clang loop vectorize(enable)")
+#define ATTR_SCALAR
+#define ATTR_AVX512 __attribute__((target("avx512f"), min_vector_width(512)))
+#else
+#define LOOP_SCALAR
+#define LOOP_VECTOR _Pragma("GCC ivdep")
+#define ATTR_SCALAR __attribute__((optimize("no-tree-vectorize")))
+#define ATTR_AVX512 __attribute__((target("avx512f,prefer-vector-width=512")))
+#endif
+#define ATTR_SSE42 __attribute__((target("sse4.2")))
+#define ATTR_AVX2 __attribute__((target("avx2,fma")))
+
+// One entry of the kernel registry. A call of run() makes `passes` passes
+// over N elements, each pass doing flops_per_elem and moving bytes_per_elem
+// per element.
+typedef struct {
+  const char *name;
+  const char *desc;
+  void (*run)(bench_data_t *data, int N);
+  int fixed_n;  // the only N the kernel may run at, 0 for any N
+  long passes;
+  double flops_per_elem;
+  double bytes_per_elem;
+  // run() compiled for each ISA, NULL if the kernel has no clones
+  void (*clones[ISA_COUNT])(bench_data_t *data, int N);
+  int reduction;  // run() sums d[0..N) `passes` times into bench_sink
+} kernel_t;
+
+// The clones array of kernel_t for functions named kernel_scalar, ...
+#define CLONES(kernel) {kernel##_scalar, kernel##_sse42, kernel##_avx2, kernel##_avx512}
+
+extern const kernel_t kernels[];
+extern const int num_kernels;
+
+// Return the kernel called name, or NULL
+const kernel_t *find_kernel(const char *name);
+
+typedef struct {
+  int warmup;       // untimed samples before the timed ones
+  int reps;         // timed samples
+  double min_time;  // repeat calls within a sample until it lasts this long
+  int isa;          // clone to run, or ISA_BUILD
+  int counters;     // read the hardware counters around the timed samples
+} bench_config_t;
+
+typedef struct {
+  const kernel_t *kernel;
+  int N;
+  int isa;  // ISA_BUILD for kernels without clones
+  long calls;  // kernel calls per sample
+  int reps;
+  double median;  // seconds per call
+  double min;
+  double stddev;
+  double gflops;  // at the median time
+  double gbs;
+  double error;  // relative error of a reduction against a long double sum, NAN otherwise
+  double counts[FASTCOUNT_COUNT];  // hardware counters per call, -1 if not counted
+} bench_result_t;
+
+// Time kernel at size N
+bench_result_t bench_run(const kernel_t *kernel, bench_data_t *data, int N, const bench_config_t *config);
+
+typedef enum { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON } bench_format_t;
+
+// Suffix of the build (".novec", ".vec.avx2", ...) set by the Makefile
+extern const char *const bench_variant;
+
+// Write results in a format, tagged with the build variant (e.g. ".vec.avx2")
+// so the output of several builds can be joined
+void bench_begin(FILE *out, bench_format_t format);
+void bench_report(FILE *out, bench_format_t format, const bench_result_t *result, int first);
+void bench_end(FILE *out, bench_format_t format);
+
+// Print the results of every kernel and size side by side per ISA, with the
+// speedup over the scalar clone
+void bench_speedup(FILE *out, const bench_result_t *results, int count);
+
+// Print the hardware counters of every result per element, with the IPC and
+// the share of FP instructions that are vector instructions
+void bench_counters(FILE *out, const bench_result_t *results, int count);
+
+#endif
@@ -94,4 +94,127 @@ time_t time(time_t *) __attribute__((deprecated));
 
 #endif  // LINUX
 
+// Hardware counters around a measured region, read with perf_event_open on
+// Linux. They are optional: a counter the kernel, the CPU or the permissions
+// (perf_event_paranoid) do not provide reads as -1, and elsewhere they all do.
+typedef enum {
+  FASTCOUNT_CYCLES,
+  FASTCOUNT_INSTRUCTIONS,
+  FASTCOUNT_BRANCH_MISSES,
+  FASTCOUNT_L1D_MISSES,
+  FASTCOUNT_LLC_MISSES,
+  FASTCOUNT_FP_SCALAR,  // retired scalar FP instructions (Intel only)
+  FASTCOUNT_FP_VECTOR,  // retired packed FP instructions of any width (Intel only)
+  FASTCOUNT_COUNT
+} fastcount_t;
+
+typedef struct {
+  int fd[FASTCOUNT_COUNT];  // -1 for counters that could not be opened
+} fastcounters_t;
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Only declared by unistd.h with _DEFAULT_SOURCE
+long syscall(long number, ...);
+
+// Open the counters of the calling thread, counting user space only. Returns
+// how many could be opened.
+static inline int fastcounters_open(fastcounters_t *c) {
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[FASTCOUNT_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    // FP_ARITH_INST_RETIRED (event 0xC7): umask 0x03 is scalar single and
+    // double, 0xFC packed 128, 256 and 512-bit
+    {PERF_TYPE_RAW, 0x03C7},
+    {PERF_TYPE_RAW, 0xFCC7},
+  };
+  int intel = __builtin_cpu_is("intel");
+  int opened = 0;
+  for (int i = 0; i < FASTCOUNT_COUNT; i++) {
+    c->fd[i] = -1;
+    if (events[i].type == PERF_TYPE_RAW && !intel)
+      continue;
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    c->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    opened += c->fd[i] >= 0;
+  }
+  return opened;
+}
+
+static inline void fastcounters_start(fastcounters_t *c) {
+  for (int i = 0; i < FASTCOUNT_COUNT; i++) {
+    if (c->fd[i] >= 0) {
+      ioctl(c->fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(c->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+// Store the counts since fastcounters_start() in values, scaled up when the
+// kernel multiplexed a counter for part of the region
+static inline void fastcounters_stop(fastcounters_t *c, double *values) {
+  for (int i = 0; i < FASTCOUNT_COUNT; i++) {
+    uint64_t data[3];  // value, time enabled, time running
+    values[i] = -1;
+    if (c->fd[i] < 0)
+      continue;
+    ioctl(c->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(c->fd[i], data, sizeof(data)) == sizeof(data) && data[2] > 0)
+      values[i] = (double)data[0] * data[1] / data[2];
+  }
+}
+
+static inline void fastcounters_close(fastcounters_t *c) {
+  for (int i = 0; i < FASTCOUNT_COUNT; i++) {
+    if (c->fd[i] >= 0)
+      close(c->fd[i]);
+    c->fd[i] = -1;
+  }
+}
+
+#else  // no perf_event_open
+
+static inline int fastcounters_open(fastcounters_t *c) {
+  for (int i = 0; i < FASTCOUNT_COUNT; i++)
+    c->fd[i] = -1;
+  return 0;
+}
+
+static inline void fastcounters_start(fastcounters_t *c) {
+  (void)c;
+}
+
+static inline void fastcounters_stop(fastcounters_t *c, double *values) {
+  (void)c;
+  for (int i = 0; i < FASTCOUNT_COUNT; i++)
+    values[i] = -1;
+}
+
+static inline void fastcounters_close(fastcounters_t *c) {
+  (void)c;
+}
+
+#endif  // __linux__
+
 #endif  // INCLUDED_FASTTIME_DOT_H
@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "reduce.h"
+#include "test.h"
+
+extern void test1(float *a, float *b, float *c, int N);
+extern void test2(float *__restrict a, float *__restrict b, float *__restrict c, int N);
+extern double test3(double *__restrict a, int N);
+
+_Thread_local volatile double bench_sink;
+
+// The assignment tests assume N == 1024 and repeat their loop I times
+static void run_test1(bench_data_t *data, int N) { test1(data->a, data->b, data->c, N); }
+static void run_test2(bench_data_t *data, int N) { test2(data->a, data->b, data->c, N); }
+static void run_test3(bench_data_t *data, int N) { bench_sink = test3(data->d, N); }
+
+// Single passes of the same loops for any N, for the size sweep, as built
+// with the Makefile flags (--isa build) and cloned for each ISA
+#define DEFINE_KERNELS(ISA, ATTR, LOOP)                                                \
+  ATTR static void add_##ISA(bench_data_t *data, int N) {                              \
+    float *__restrict a = data->a, *__restrict b = data->b, *__restrict c = data->c;   \
+    LOOP for (int j = 0; j < N; j++)                                                   \
+      c[j] = a[j] + b[j];                                                              \
+  }                                                                                    \
+  ATTR static void max_##ISA(bench_data_t *data, int N) {                              \
+    float *__restrict a = data->a, *__restrict b = data->b, *__restrict c = data->c;   \
+    LOOP for (int j = 0; j < N; j++)                                                   \
+      c[j] = b[j] > a[j] ? b[j] : a[j];                                                \
+  }                                                                                    \
+  ATTR static void sum_##ISA(bench_data_t *data, int N) {                              \
+    double *__restrict a = data->d;                                                    \
+    double b = 0;                                                                      \
+    LOOP for (int j = 0; j < N; j++)                                                   \
+      b += a[j];                                                                       \
+    bench_sink = b;                                                                    \
+  }
+
+DEFINE_KERNELS(build, , )
+DEFINE_KERNELS(scalar, ATTR_SCALAR, LOOP_SCALAR)
+DEFINE_KERNELS(sse42, ATTR_SSE42, LOOP_VECTOR)
+DEFINE_KERNELS(avx2, ATTR_AVX2, LOOP_VECTOR)
+DEFINE_KERNELS(avx512, ATTR_AVX512, LOOP_VECTOR)
+
+// Reductions that keep their result accurate and independent of the
+// vector width (reduce.c), cloned like the kernels above
+#define DEFINE_REDUCTIONS(ISA)                                                          \
+  static void sum_multi_run_##ISA(bench_data_t *data, int N) {                          \
+    bench_sink = sum_multi_##ISA(data->d, N);                                           \
+  }                                                                                     \
+  static void sum_pairwise_run_##ISA(bench_data_t *data, int N) {                       \
+    bench_sink = sum_pairwise_##ISA(data->d, N);                                        \
+  }                                                                                     \
+  static void sum_kahan_run_##ISA(bench_data_t *data, int N) {                          \
+    bench_sink = sum_kahan_##ISA(data->d, N);                                           \
+  }                                                                                     \
+  static void sum_repro_run_##ISA(bench_data_t *data, int N) {                          \
+    bench_sink = sum_repro_##ISA(data->d, N, data->team);                               \
+  }
+
+DEFINE_REDUCTIONS(build)
+DEFINE_REDUCTIONS(scalar)
+DEFINE_REDUCTIONS(sse42)
+DEFINE_REDUCTIONS(avx2)
+DEFINE_REDUCTIONS(avx512)
+
+// Bytes count the loads and stores of the loop, not write-allocate traffic
+const kernel_t kernels[] = {
+  {"test1", "c = a + b (test1.c)", run_test1, 1024, I, 1, 12},
+  {"test2", "c = max(a, b) (test2.c)", run_test2, 1024, I, 1, 12},
+  {"test3", "sum of doubles (test3.c)", run_test3, 1024, I, 1, 8, {NULL}, 1},
+  {"add", "c = a + b, one pass", add_build, 0, 1, 1, 12, CLONES(add)},
+  {"max", "c = max(a, b), one pass", max_build, 0, 1, 1, 12, CLONES(max)},
+  {"sum", "sum of doubles, one pass", sum_build, 0, 1, 1, 8, CLONES(sum), 1},
+  {"sum_multi", "sum of doubles, 8 accumulators", sum_multi_run_build, 0, 1, 1, 8, CLONES(sum_multi_run), 1},
+  {"sum_pairwise", "sum of doubles, pairwise over blocks", sum_pairwise_run_build, 0, 1, 1, 8, CLONES(sum_pairwise_run),
+   1},
+  {"sum_kahan", "sum of doubles, 8 Kahan accumulators", sum_kahan_run_build, 0, 1, 4, 8, CLONES(sum_kahan_run), 1},
+  {"sum_repro", "sum of doubles, fixed order on -T threads", sum_repro_run_build, 0, 1, 1, 8, CLONES(sum_repro_run),
+   1},
+};
+
+const int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
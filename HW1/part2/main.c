@@ -1,46 +1,144 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "fasttime.h"
+#include <string.h>
+#include "arena.h"
+#include "bench.h"
+#include "roofline.h"
+#include "scale.h"
 #include "test.h"
 
-void usage(const char *progname);
-void initValue(float *values1, float *values2, double *value3, float *output, unsigned int N);
+#define MAX_SIZES 64
+#define MAX_KERNELS 64
 
-extern void test1(float *a, float *b, float *c, int N);
-extern void test2(float *__restrict a, float *__restrict b, float *__restrict c, int N);
-extern double test3(double *__restrict a, int N) ;
+void usage(const char *progname);
+void initValue(bench_data_t *data, int threads);
+int parseSizes(char *list, int *sizes, const char *what);
+int parseTests(char *list, const kernel_t **selected);
 
 int main(int argc, char **argv) {
-  int N = 1024;
-  int whichTestToRun = 1;
+  int sizes[MAX_SIZES] = {1024};
+  int numSizes = 1;
+  const kernel_t *selected[MAX_KERNELS] = {find_kernel("test1")};
+  int numSelected = 1;
+  bench_config_t config = {0, 1, 0, isa_best(), 0};
+  bench_format_t format = FORMAT_TABLE;
+  const char *outputPath = NULL;
+  int threads = 1;
+  int hugePages = 0;
+  int allIsas = 0;
+  int roofline = 0;
+  int scaleThreads[MAX_SIZES];
+  int numScale = 0;
 
   // parse commandline options
   int opt;
   static struct option long_options[] = {
     {"size", 1, 0, 's'},
+    {"sweep", 0, 0, 'S'},
     {"test", 1, 0, 't'},
+    {"reps", 1, 0, 'r'},
+    {"warmup", 1, 0, 'w'},
+    {"min-time", 1, 0, 'm'},
+    {"format", 1, 0, 'f'},
+    {"output", 1, 0, 'o'},
+    {"isa", 1, 0, 'i'},
+    {"threads", 1, 0, 'T'},
+    {"huge-pages", 0, 0, 'H'},
+    {"roofline", 0, 0, 'R'},
+    {"counters", 0, 0, 'P'},
+    {"scale", 1, 0, 'X'},
+    {"list", 0, 0, 'l'},
     {"help", 0, 0, '?'},
     {0 ,0, 0, 0}
   };
 
-  while ((opt = getopt_long(argc, argv, "st:?", long_options, NULL)) != EOF) {
+  while ((opt = getopt_long(argc, argv, "s:St:r:w:m:f:o:i:T:HRPX:lh?", long_options, NULL)) != EOF) {
 
     switch (opt) {
       case 's':
-        N = atoi(optarg);
-        if (N <= 0) {
-          printf("Error: Workload size is set to %d (<0).\n", N);
+        numSizes = parseSizes(optarg, sizes, "Workload size");
+        if (numSizes <= 0)
           return -1;
-        }
+        break;
+      case 'S':
+        numSizes = 0;
+        for (int n = 256; n <= (1 << 24); n *= 4)
+          sizes[numSizes++] = n;
         break;
       case 't':
-        whichTestToRun = atoi(optarg);
-        if (whichTestToRun <= 0 || whichTestToRun >= 4) {
-          printf("Error: test%d() is not available.\n", whichTestToRun);
+        numSelected = parseTests(optarg, selected);
+        if (numSelected <= 0)
+          return -1;
+        break;
+      case 'r':
+        config.reps = atoi(optarg);
+        if (config.reps <= 0) {
+          printf("Error: Repetitions are set to %d (<=0).\n", config.reps);
           return -1;
         }
         break;
+      case 'w':
+        config.warmup = atoi(optarg);
+        break;
+      case 'm':
+        config.min_time = atof(optarg);
+        break;
+      case 'f':
+        if (strcmp(optarg, "table") == 0)
+          format = FORMAT_TABLE;
+        else if (strcmp(optarg, "csv") == 0)
+          format = FORMAT_CSV;
+        else if (strcmp(optarg, "json") == 0)
+          format = FORMAT_JSON;
+        else {
+          printf("Error: Unknown output format %s.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'o':
+        outputPath = optarg;
+        break;
+      case 'i':
+        if (strcmp(optarg, "all") == 0)
+          allIsas = 1;
+        else if (isa_parse(optarg, &config.isa) != 0) {
+          printf("Error: Unknown ISA %s.\n", optarg);
+          return -1;
+        } else if (config.isa != ISA_BUILD && !isa_supported(config.isa)) {
+          printf("Error: This CPU does not support %s.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'T':
+        threads = atoi(optarg);
+        if (threads <= 0) {
+          printf("Error: Thread count is set to %d (<=0).\n", threads);
+          return -1;
+        }
+        break;
+      case 'H':
+        hugePages = 1;
+        break;
+      case 'R':
+        roofline = 1;
+        break;
+      case 'P':
+        config.counters = 1;
+        break;
+      case 'X':
+        numScale = parseSizes(optarg, scaleThreads, "Thread count");
+        if (numScale <= 0)
+          return -1;
+        break;
+      case 'l':
+        for (int i = 0; i < num_kernels; i++) {
+          if (kernels[i].fixed_n)
+            printf("  %-12s %s, N = %d only\n", kernels[i].name, kernels[i].desc, kernels[i].fixed_n);
+          else
+            printf("  %-12s %s\n", kernels[i].name, kernels[i].desc);
+        }
+        return 0;
       case 'h':
       default:
         usage(argv[0]);
@@ -48,44 +146,192 @@ int main(int argc, char **argv) {
     }
   }
 
-#define AVX_ALIGNMENT 256
-  float *values1 = (float *)__builtin_alloca_with_align(N * sizeof(float), AVX_ALIGNMENT);
-  float *values2 = (float *)__builtin_alloca_with_align(N * sizeof(float), AVX_ALIGNMENT);
-  double *values3 = (double *)__builtin_alloca_with_align(N * sizeof(double), AVX_ALIGNMENT);
-  float *output = (float *)__builtin_alloca_with_align(N * sizeof(float), AVX_ALIGNMENT);
-#undef AVX_ALIGNMENT
-  initValue(values1, values2, values3, output, N);
-
-  printf("Running test%d()...\n", whichTestToRun);
-  fasttime_t time1 = gettime();
-  switch (whichTestToRun) {
-    case 1: test1(values1, values2, output, N); break;
-    case 2: test2(values1, values2, output, N); break;
-    case 3: test3(values3, N); break;
+  FILE *out = stdout;
+  if (outputPath && !(out = fopen(outputPath, "w"))) {
+    printf("Error: Cannot write %s.\n", outputPath);
+    return -1;
   }
-  fasttime_t time2 = gettime();
 
-  double elapsedf = tdiff(time1, time2);
-  printf("Elapsed execution time of the loop in test%d():\n", whichTestToRun);
-  printf("%lfsec (N: %d, I: %d)\n", elapsedf, N, I);
+  // Thread counts run in ascending order, the first one is the baseline
+  if (numScale > 0) {
+    for (int i = 1; i < numScale; i++) {
+      for (int j = i; j > 0 && scaleThreads[j - 1] > scaleThreads[j]; j--) {
+        int t = scaleThreads[j];
+        scaleThreads[j] = scaleThreads[j - 1];
+        scaleThreads[j - 1] = t;
+      }
+    }
+    int status = scale_sweep(out, format, selected, numSelected, sizes, numSizes, scaleThreads, numScale, &config,
+                             allIsas, hugePages);
+    if (out != stdout)
+      fclose(out);
+    return status;
+  }
+
+  int maxN = 0;
+  for (int i = 0; i < numSizes; i++)
+    maxN = sizes[i] > maxN ? sizes[i] : maxN;
+  for (int i = 0; i < numSelected; i++)
+    maxN = selected[i]->fixed_n > maxN ? selected[i]->fixed_n : maxN;
+  if (roofline && roofline_max_n() > maxN)
+    maxN = roofline_max_n();
+
+  // The arrays live in one arena on the heap, so sizes past the caches fit.
+  // They are first written by the init threads, which places their pages.
+  arena_t arena;
+  size_t floats = arena_footprint((size_t)maxN * sizeof(float));
+  size_t doubles = arena_footprint((size_t)maxN * sizeof(double));
+  if (arena_init(&arena, 3 * floats + doubles, hugePages) != 0) {
+    printf("Error: Cannot allocate %zu MB for N = %d.\n", (3 * floats + doubles) >> 20, maxN);
+    return -1;
+  }
+  if (hugePages && !arena.huge)
+    fprintf(stderr, "Note: huge pages are not available, using normal pages\n");
+  bench_data_t data;
+  data.a = arena_alloc(&arena, (size_t)maxN * sizeof(float));
+  data.b = arena_alloc(&arena, (size_t)maxN * sizeof(float));
+  data.d = arena_alloc(&arena, (size_t)maxN * sizeof(double));
+  data.c = arena_alloc(&arena, (size_t)maxN * sizeof(float));
+  data.capacity = maxN;
+  data.threads = threads;
+  initValue(&data, threads);
+  // Created once, so the timed calls of sum_repro do not start threads
+  data.team = threads > 1 ? team_create(threads) : NULL;
+
+  // Without counters the kernels are still timed, and their counts print as -
+  if (config.counters) {
+    fastcounters_t counters;
+    int opened = fastcounters_open(&counters);
+    fastcounters_close(&counters);
+    if (opened < FASTCOUNT_COUNT)
+      fprintf(stderr, "Note: %d of %d hardware counters are available\n", opened, FASTCOUNT_COUNT);
+  }
+
+  // The ceilings are measured before the kernels, which then overwrite c
+  roofline_t roof;
+  if (roofline) {
+    roofline_measure(&roof, &data, &config, stdout);
+    printf("\n");
+  }
+
+  // Kernels with a fixed N run once at it, whatever the requested sizes.
+  // With --isa all every kernel runs as each clone the CPU supports.
+  bench_result_t *results = malloc((size_t)numSelected * numSizes * ISA_COUNT * sizeof(bench_result_t));
+  int numResults = 0;
+  bench_begin(out, format);
+  for (int k = 0; k < numSelected; k++) {
+    const kernel_t *kernel = selected[k];
+    for (int i = 0; i < (kernel->fixed_n ? 1 : numSizes); i++) {
+      int N = kernel->fixed_n ? kernel->fixed_n : sizes[i];
+      if (kernel->fixed_n && (numSizes != 1 || sizes[0] != N))
+        fprintf(stderr, "Note: %s() only runs at N = %d\n", kernel->name, N);
+      for (int isa = 0; isa < (allIsas && kernel->clones[0] ? ISA_COUNT : 1); isa++) {
+        if (allIsas) {
+          if (!isa_supported(isa))
+            continue;
+          config.isa = isa;
+        }
+        results[numResults] = bench_run(kernel, &data, N, &config);
+        bench_report(out, format, &results[numResults], numResults == 0);
+        numResults++;
+        fflush(out);
+      }
+    }
+  }
+  bench_end(out, format);
+  if (out != stdout)
+    fclose(out);
+  if (allIsas && (format == FORMAT_TABLE || out != stdout)) {
+    printf("\n");
+    bench_speedup(stdout, results, numResults);
+  }
+  if (config.counters) {
+    printf("\n");
+    bench_counters(stdout, results, numResults);
+  }
+  if (roofline) {
+    printf("\n");
+    roofline_place(stdout, &roof, results, numResults);
+  }
+  free(results);
+  if (data.team)
+    team_destroy(data.team);
+  arena_free(&arena);
   return 0;
 }
 
 void usage(const char *progname) {
   printf("Usage: %s [options]\n", progname);
   printf("Program Options:\n");
-  printf("  -s  --size <N>     Use workload size N (Default = 1024)\n");
-  printf("  -t  --test <N>     Just run the testN function (Default = 1)\n");
-  printf("  -h  --help         This message\n");
+  printf("  -s  --size <N,...>     Use workload sizes N (Default = 1024)\n");
+  printf("  -S  --sweep            Use workload sizes 256, 1024, ..., 2^24\n");
+  printf("  -t  --test <name,...>  Run these kernels, testN or N for the testN function,\n");
+  printf("                         all for every kernel (Default = test1)\n");
+  printf("  -r  --reps <R>         Report the median, min and stddev of R samples (Default = 1)\n");
+  printf("  -w  --warmup <W>       Run W untimed samples first (Default = 0)\n");
+  printf("  -m  --min-time <sec>   Repeat the kernel within a sample until it takes sec\n");
+  printf("  -f  --format <fmt>     Print results as table, csv or json (Default = table)\n");
+  printf("  -o  --output <file>    Write results to file instead of stdout\n");
+  printf("  -i  --isa <isa>        Run the clones for scalar, sse4.2, avx2, avx512, best (the\n");
+  printf("                         widest this CPU runs, default), build (the Makefile flags)\n");
+  printf("                         or all, which prints a speedup table\n");
+  printf("  -T  --threads <T>      Initialize the arrays and run sum_repro on T threads (Default = 1)\n");
+  printf("  -H  --huge-pages       Back the arrays with huge pages when available\n");
+  printf("  -P  --counters         Read cycles, instructions, branch and cache misses and\n");
+  printf("                         scalar and vector FP instructions with perf_event_open\n");
+  printf("  -R  --roofline         Measure the peak GFLOP/s and the bandwidth of each cache\n");
+  printf("                         level and DRAM, and place the kernels on the roofline\n");
+  printf("  -X  --scale <T,...>    Run the kernels on pinned teams of T threads, each over\n");
+  printf("                         its own part of arrays it placed, and report the speedup\n");
+  printf("                         and efficiency over the fewest threads\n");
+  printf("  -l  --list             List the kernels\n");
+  printf("  -h  --help             This message\n");
+}
+
+// Parse a comma separated list of positive numbers, returns how many there
+// are or -1
+int parseSizes(char *list, int *sizes, const char *what) {
+  int count = 0;
+  for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+    int N = atoi(item);
+    if (N <= 0) {
+      printf("Error: %s is set to %d (<=0).\n", what, N);
+      return -1;
+    }
+    if (count == MAX_SIZES) {
+      printf("Error: More than %d values for %s.\n", MAX_SIZES, what);
+      return -1;
+    }
+    sizes[count++] = N;
+  }
+  return count;
 }
 
-void initValue(float *values1, float *values2, double *values3, float *output, unsigned int N) {
-  for (unsigned int i=0; i<N; i++)
-  {
-    // random input values
-    values1[i] = -1.0f + 4.0f * rand() / (float)RAND_MAX;
-    values2[i] = -1.0f + 4.0f * rand() / (float)RAND_MAX;
-    values3[i] = -1.0 + 4.0 * rand() / (double)RAND_MAX;
-    output[i] = 0.0f;
+// Parse a comma separated list of kernels, returns how many there are or -1
+int parseTests(char *list, const kernel_t **selected) {
+  int count = 0;
+  for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+    if (strcmp(item, "all") == 0) {
+      for (int i = 0; i < num_kernels && count < MAX_KERNELS; i++)
+        selected[count++] = &kernels[i];
+      continue;
+    }
+    char name[32];
+    if (item[0] >= '0' && item[0] <= '9')
+      snprintf(name, sizeof(name), "test%s", item);
+    else
+      snprintf(name, sizeof(name), "%s", item);
+    const kernel_t *kernel = find_kernel(name);
+    if (!kernel) {
+      printf("Error: %s() is not available.\n", name);
+      return -1;
+    }
+    if (count < MAX_KERNELS)
+      selected[count++] = kernel;
   }
+  return count;
+}
+
+void initValue(bench_data_t *data, int threads) {
+  parallel_for(threads, data->capacity, bench_init, data);
 }
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include "bench.h"
+#include "reduce.h"
+
+// Adds up lanes[0..n) as a balanced tree, in an order that depends only on n
+static double tree_sum(double *lanes, int n) {
+  for (int width = 1; width < n; width *= 2) {
+    for (int i = 0; i + width < n; i += 2 * width)
+      lanes[i] += lanes[i + width];
+  }
+  return n > 0 ? lanes[0] : 0;
+}
+
+// Compensation only works if the compiler keeps the order of the additions,
+// also in -ffast-math builds
+#if defined(__clang__)
+#define PRECISE_FP _Pragma("clang fp reassociate(off)")
+#define PRECISE_FP_ATTR
+#else
+#define PRECISE_FP
+#define PRECISE_FP_ATTR __attribute__((optimize("no-fast-math")))
+#endif
+
+typedef struct {
+  const double *a;
+  int N;
+  double *partial;
+  double (*sum)(const double *a, int N);  // sum_multi of the clone
+} repro_t;
+
+static void repro_blocks(int member, size_t begin, size_t end, void *ctx) {
+  (void)member;
+  repro_t *r = ctx;
+  for (size_t b = begin; b < end; b++) {
+    int first = b * REDUCE_BLOCK;
+    r->partial[b] = r->sum(r->a + first, r->N - first < REDUCE_BLOCK ? r->N - first : REDUCE_BLOCK);
+  }
+}
+
+static double repro(double (*sum)(const double *a, int N), const double *a, int N, team_t *team) {
+  int blocks = (N + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+  repro_t r = {a, N, malloc((blocks > 0 ? blocks : 1) * sizeof(double)), sum};
+  if (team)
+    team_run(team, blocks, repro_blocks, &r);
+  else
+    repro_blocks(0, 0, blocks, &r);
+  double total = tree_sum(r.partial, blocks);
+  free(r.partial);
+  return total;
+}
+
+// Each lane of sum_multi is its own serial sum, so the lanes vectorize
+// without reordering any additions. The Kahan lanes are combined with
+// Neumaier's variant, which also handles a lane larger than the running
+// total.
+#define DEFINE_REDUCE(ISA, ATTR, LOOP)                                                     \
+  ATTR double sum_multi_##ISA(const double *a, int N) {                                    \
+    double acc[REDUCE_LANES] = {0};                                                        \
+    int j = 0;                                                                             \
+    for (; j + REDUCE_LANES <= N; j += REDUCE_LANES) {                                     \
+      LOOP for (int k = 0; k < REDUCE_LANES; k++)                                          \
+        acc[k] += a[j + k];                                                                \
+    }                                                                                      \
+    for (int k = 0; j < N; j++, k++)                                                       \
+      acc[k] += a[j];                                                                      \
+    return tree_sum(acc, REDUCE_LANES);                                                    \
+  }                                                                                        \
+  ATTR double sum_pairwise_##ISA(const double *a, int N) {                                 \
+    int blocks = (N + REDUCE_BLOCK - 1) / REDUCE_BLOCK;                                    \
+    double *partial = malloc((blocks > 0 ? blocks : 1) * sizeof(double));                  \
+    for (int b = 0; b < blocks; b++) {                                                     \
+      int begin = b * REDUCE_BLOCK;                                                        \
+      int n = N - begin < REDUCE_BLOCK ? N - begin : REDUCE_BLOCK;                         \
+      partial[b] = sum_multi_##ISA(a + begin, n);                                          \
+    }                                                                                      \
+    double sum = tree_sum(partial, blocks);                                                \
+    free(partial);                                                                         \
+    return sum;                                                                            \
+  }                                                                                        \
+  ATTR PRECISE_FP_ATTR double sum_kahan_##ISA(const double *a, int N) {                    \
+    PRECISE_FP                                                                             \
+    double sum[REDUCE_LANES] = {0}, comp[REDUCE_LANES] = {0};                              \
+    int j = 0;                                                                             \
+    for (; j + REDUCE_LANES <= N; j += REDUCE_LANES) {                                     \
+      LOOP for (int k = 0; k < REDUCE_LANES; k++) {                                        \
+        double y = a[j + k] - comp[k];                                                     \
+        double t = sum[k] + y;                                                             \
+        comp[k] = (t - sum[k]) - y;                                                        \
+        sum[k] = t;                                                                        \
+      }                                                                                    \
+    }                                                                                      \
+    for (int k = 0; j < N; j++, k++) {                                                     \
+      double y = a[j] - comp[k];                                                           \
+      double t = sum[k] + y;                                                               \
+      comp[k] = (t - sum[k]) - y;                                                          \
+      sum[k] = t;                                                                          \
+    }                                                                                      \
+    double total = 0, c = 0;                                                               \
+    for (int k = 0; k < REDUCE_LANES; k++) {                                               \
+      double x = sum[k] - comp[k];                                                         \
+      double t = total + x;                                                                \
+      c += (total >= x || total <= -x) ? (total - t) + x : (x - t) + total;                \
+      total = t;                                                                           \
+    }                                                                                      \
+    return total + c;                                                                      \
+  }                                                                                        \
+  double sum_repro_##ISA(const double *a, int N, team_t *team) {                           \
+    return repro(sum_multi_##ISA, a, N, team);                                             \
+  }
+
+DEFINE_REDUCE(build, , )
+DEFINE_REDUCE(scalar, ATTR_SCALAR, LOOP_SCALAR)
+DEFINE_REDUCE(sse42, ATTR_SSE42, LOOP_VECTOR)
+DEFINE_REDUCE(avx2, ATTR_AVX2, LOOP_VECTOR)
+DEFINE_REDUCE(avx512, ATTR_AVX512, LOOP_VECTOR)
@@ -0,0 +1,37 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include "arena.h"
+
+// Independent accumulators of the multi-lane sums, a multiple of the widest
+// vector (8 doubles with AVX-512)
+#define REDUCE_LANES 8
+
+// Elements per block of the blocked sums
+#define REDUCE_BLOCK 4096
+
+// Each reduction is built with the Makefile flags (sum_multi_build, ...) and
+// cloned for each ISA (sum_multi_scalar, ...), like the kernels in kernels.c.
+//
+// sum_multi: REDUCE_LANES accumulators, added up pairwise at the end.
+// sum_pairwise: multi-lane sums of REDUCE_BLOCK element blocks, added up
+// pairwise. The error grows with log(N / REDUCE_BLOCK) instead of N.
+// sum_kahan: REDUCE_LANES Kahan-compensated accumulators, combined with
+// compensation.
+// sum_repro: blocked pairwise sum whose blocks are spread over the members
+// of team (on the calling thread if team is NULL). The blocks and the order
+// they are added in do not depend on the team, so the result is bitwise
+// identical for any thread count.
+#define DECLARE_REDUCE(ISA)                                       \
+  double sum_multi_##ISA(const double *a, int N);                 \
+  double sum_pairwise_##ISA(const double *a, int N);              \
+  double sum_kahan_##ISA(const double *a, int N);                 \
+  double sum_repro_##ISA(const double *a, int N, team_t *team);
+
+DECLARE_REDUCE(build)
+DECLARE_REDUCE(scalar)
+DECLARE_REDUCE(sse42)
+DECLARE_REDUCE(avx2)
+DECLARE_REDUCE(avx512)
+
+#endif
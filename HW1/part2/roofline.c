@@ -0,0 +1,221 @@
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+#include "roofline.h"
+
+// Independent multiply-add chains of the peak kernel, enough to cover the
+// latency of two FMA units
+#define PEAK_CHAINS 12
+
+// Chain iterations per call, the chains converge to PEAK_Y / (1 - PEAK_X)
+// without denormals
+#define PEAK_N 1024
+#define PEAK_X 0.999
+#define PEAK_Y 0.001
+
+// The sweep covers working sets from ROOFLINE_MIN_BYTES to at least
+// ROOFLINE_DRAM_FACTOR times the last level cache
+#define ROOFLINE_MIN_BYTES 4096
+#define ROOFLINE_DRAM_FACTOR 2
+#define ROOFLINE_DRAM_MIN_BYTES (64 << 20)
+
+static const char *const level_names[ROOFLINE_LEVELS] = {"L1", "L2", "L3", "DRAM"};
+
+// Scalar and SSE have no FMA, their chains multiply and then add
+#define MADD_SD(a, x, y) _mm_add_sd(_mm_mul_sd(a, x), y)
+#define MADD_PD(a, x, y) _mm_add_pd(_mm_mul_pd(a, x), y)
+
+// Every lane of every chain goes into bench_sink, so none of them is dead
+#define DEFINE_PEAK(ISA, ATTR, VEC, SET, MADD)                                         \
+  ATTR static void peak_##ISA(bench_data_t *data, int N) {                             \
+    VEC x = SET(PEAK_X), y = SET(PEAK_Y), acc[PEAK_CHAINS];                            \
+    for (int k = 0; k < PEAK_CHAINS; k++)                                              \
+      acc[k] = SET(1.0 + k);                                                           \
+    for (int j = 0; j < N; j++) {                                                      \
+      for (int k = 0; k < PEAK_CHAINS; k++)                                            \
+        acc[k] = MADD(acc[k], x, y);                                                   \
+    }                                                                                  \
+    double lanes[sizeof(VEC) / sizeof(double)], total = 0;                             \
+    for (int k = 0; k < PEAK_CHAINS; k++) {                                            \
+      memcpy(lanes, &acc[k], sizeof(VEC));                                             \
+      for (size_t l = 0; l < sizeof(VEC) / sizeof(double); l++)                        \
+        total += lanes[l];                                                             \
+    }                                                                                  \
+    bench_sink = total;                                                                \
+  }
+
+DEFINE_PEAK(scalar, ATTR_SCALAR, __m128d, _mm_set_sd, MADD_SD)
+DEFINE_PEAK(sse42, ATTR_SSE42, __m128d, _mm_set1_pd, MADD_PD)
+DEFINE_PEAK(avx2, ATTR_AVX2, __m256d, _mm256_set1_pd, _mm256_fmadd_pd)
+DEFINE_PEAK(avx512, ATTR_AVX512, __m512d, _mm512_set1_pd, _mm512_fmadd_pd)
+
+// Two flops per lane and chain
+static const kernel_t peak_kernels[ISA_COUNT] = {
+  {"peak", "FMA chains, scalar", peak_scalar, PEAK_N, 1, 2 * PEAK_CHAINS, 0},
+  {"peak", "FMA chains, sse4.2", peak_sse42, PEAK_N, 1, 2 * PEAK_CHAINS * 2, 0},
+  {"peak", "FMA chains, avx2", peak_avx2, PEAK_N, 1, 2 * PEAK_CHAINS * 4, 0},
+  {"peak", "FMA chains, avx512", peak_avx512, PEAK_N, 1, 2 * PEAK_CHAINS * 8, 0},
+};
+
+// STREAM triad on the float arrays of the harness, counted like the add
+// kernel (loads and stores, no write-allocate traffic)
+#define DEFINE_TRIAD(ISA, ATTR, LOOP)                                                  \
+  ATTR static void triad_##ISA(bench_data_t *data, int N) {                            \
+    float *__restrict a = data->a, *__restrict b = data->b, *__restrict c = data->c;   \
+    LOOP for (int j = 0; j < N; j++)                                                   \
+      c[j] = a[j] + 3.0f * b[j];                                                       \
+  }
+
+DEFINE_TRIAD(scalar, ATTR_SCALAR, LOOP_SCALAR)
+DEFINE_TRIAD(sse42, ATTR_SSE42, LOOP_VECTOR)
+DEFINE_TRIAD(avx2, ATTR_AVX2, LOOP_VECTOR)
+DEFINE_TRIAD(avx512, ATTR_AVX512, LOOP_VECTOR)
+
+static const kernel_t triad = {"triad", "c = a + 3 b", triad_scalar, 0, 1, 2, 12, CLONES(triad)};
+
+// Size in bytes of a cache level from sysfs, like "48K", or fallback
+static size_t cache_size(int level, size_t fallback) {
+  for (int index = 0; index < 8; index++) {
+    char path[96], type[32] = "", size[32] = "";
+    int found = -1;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    FILE *f = fopen(path, "r");
+    if (!f)
+      break;
+    if (fscanf(f, "%d", &found) != 1)
+      found = -1;
+    fclose(f);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    if ((f = fopen(path, "r"))) {
+      if (fscanf(f, "%31s", type) != 1)
+        type[0] = '\0';
+      fclose(f);
+    }
+    if (found != level || strcmp(type, "Instruction") == 0)
+      continue;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    if ((f = fopen(path, "r"))) {
+      if (fscanf(f, "%31s", size) != 1)
+        size[0] = '\0';
+      fclose(f);
+    }
+    char *unit;
+    size_t bytes = strtoull(size, &unit, 10);
+    if (*unit == 'K')
+      bytes <<= 10;
+    else if (*unit == 'M')
+      bytes <<= 20;
+    else if (*unit == 'G')
+      bytes <<= 30;
+    if (bytes > 0)
+      return bytes;
+  }
+  return fallback;
+}
+
+static void cache_sizes(size_t *bytes) {
+  bytes[0] = cache_size(1, 32 << 10);
+  bytes[1] = cache_size(2, 1 << 20);
+  bytes[2] = cache_size(3, 32 << 20);
+}
+
+// Largest working set of the sweep, a power of two past the last level cache
+static size_t sweep_max_bytes(const size_t *cache) {
+  size_t bytes = ROOFLINE_MIN_BYTES;
+  while (bytes < ROOFLINE_DRAM_FACTOR * cache[ROOFLINE_CACHES - 1] || bytes < ROOFLINE_DRAM_MIN_BYTES)
+    bytes *= 2;
+  return bytes;
+}
+
+int roofline_max_n(void) {
+  size_t cache[ROOFLINE_CACHES];
+  cache_sizes(cache);
+  return sweep_max_bytes(cache) / triad.bytes_per_elem;
+}
+
+// The level a working set of bytes fits in
+static int level_of(const roofline_t *roof, double bytes) {
+  for (int level = 0; level < ROOFLINE_CACHES; level++) {
+    if (bytes <= roof->cache_bytes[level])
+      return level;
+  }
+  return ROOFLINE_CACHES;
+}
+
+void roofline_measure(roofline_t *roof, bench_data_t *data, bench_config_t *config, FILE *out) {
+  if (config->min_time < ROOFLINE_MIN_TIME)
+    config->min_time = ROOFLINE_MIN_TIME;
+  bench_config_t cfg = *config;
+  memset(roof, 0, sizeof(*roof));
+  cache_sizes(roof->cache_bytes);
+
+  fprintf(out, "Ceilings and kernels: samples of at least %g s, %d warmup\n\n", cfg.min_time, cfg.warmup);
+  fprintf(out, "%-8s %12s\n", "isa", "peak GFLOP/s");
+  for (int isa = 0; isa < ISA_COUNT; isa++) {
+    if (!isa_supported(isa))
+      continue;
+    roof->peak_gflops[isa] = bench_run(&peak_kernels[isa], data, PEAK_N, &cfg).gflops;
+    fprintf(out, "%-8s %12.3f\n", isa_names[isa], roof->peak_gflops[isa]);
+  }
+
+  // A cache level gets the highest bandwidth measured inside it. DRAM only
+  // counts working sets of at least ROOFLINE_DRAM_FACTOR times the last
+  // level cache, smaller ones still partly hit it.
+  fprintf(out, "\n%-12s %10s %9s %-6s\n", "working set", "N", "GB/s", "level");
+  cfg.isa = isa_best();
+  size_t max_bytes = sweep_max_bytes(roof->cache_bytes);
+  for (size_t bytes = ROOFLINE_MIN_BYTES; bytes <= max_bytes; bytes *= 2) {
+    int N = bytes / triad.bytes_per_elem;
+    if (N > data->capacity)
+      break;
+    double gbs = bench_run(&triad, data, N, &cfg).gbs;
+    int level = level_of(roof, bytes);
+    int counted = level < ROOFLINE_CACHES || bytes >= ROOFLINE_DRAM_FACTOR * roof->cache_bytes[ROOFLINE_CACHES - 1];
+    if (counted && gbs > roof->gbs[level])
+      roof->gbs[level] = gbs;
+    fprintf(out, "%10zuKB %10d %9.3f %-6s\n", bytes >> 10, N, gbs, level_names[level]);
+  }
+
+  // The ridge point is the arithmetic intensity at which a kernel running
+  // from that level stops being bandwidth bound at the widest ISA
+  double peak = roof->peak_gflops[isa_best()];
+  fprintf(out, "\n%-6s %10s %9s %12s\n", "level", "size", "GB/s", "ridge F/B");
+  for (int level = 0; level < ROOFLINE_LEVELS; level++) {
+    if (level < ROOFLINE_CACHES)
+      fprintf(out, "%-6s %8zuKB", level_names[level], roof->cache_bytes[level] >> 10);
+    else
+      fprintf(out, "%-6s %10s", level_names[level], "-");
+    if (roof->gbs[level] > 0)
+      fprintf(out, " %9.3f %12.3f\n", roof->gbs[level], peak / roof->gbs[level]);
+    else
+      fprintf(out, " %9s %12s\n", "-", "-");
+  }
+}
+
+void roofline_place(FILE *out, const roofline_t *roof, const bench_result_t *results, int count) {
+  fprintf(out, "%-12s %-7s %10s %9s %-6s %9s %9s %-7s %9s\n", "kernel", "isa", "N", "F/B", "level", "GFLOP/s",
+          "bound", "by", "of bound");
+  int above = 0;
+  for (int i = 0; i < count; i++) {
+    const bench_result_t *r = &results[i];
+    const kernel_t *kernel = r->kernel;
+    double intensity = kernel->flops_per_elem / kernel->bytes_per_elem;
+    int level = level_of(roof, (double)r->N * kernel->bytes_per_elem);
+    // The Makefile flags may vectorize for any ISA, so builds count against
+    // the widest
+    double peak = roof->peak_gflops[r->isa == ISA_BUILD ? isa_best() : r->isa];
+    double memory = intensity * roof->gbs[level];
+    int compute = memory <= 0 || peak < memory;
+    double bound = compute ? peak : memory;
+    int over = r->gflops > bound;
+    above += over;
+    fprintf(out, "%-12s %-7s %10d %9.4f %-6s %9.3f %9.3f %-7s %8.1f%%%s\n", kernel->name,
+            r->isa == ISA_BUILD ? "build" : isa_names[r->isa], r->N, intensity, level_names[level], r->gflops, bound,
+            compute ? "compute" : level_names[level], 100 * r->gflops / bound, over ? " !" : "");
+  }
+  fprintf(out, "\nF/B is the nominal intensity of the source loop, not measured traffic.\n");
+  if (above)
+    fprintf(out, "! %d result%s above the bound: the ceiling was underestimated or part of the working set\n"
+                 "  was served by a faster level than its size suggests.\n",
+            above, above == 1 ? " is" : "s are");
+}
@@ -0,0 +1,36 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "bench.h"
+
+// Data caches the bandwidth is measured for, DRAM comes after them
+#define ROOFLINE_CACHES 3
+#define ROOFLINE_LEVELS (ROOFLINE_CACHES + 1)
+
+// The ceilings of this machine
+typedef struct {
+  double peak_gflops[ISA_COUNT];  // FMA microkernel, 0 for ISAs the CPU does not run
+  size_t cache_bytes[ROOFLINE_CACHES];  // L1d, L2, L3 from sysfs
+  double gbs[ROOFLINE_LEVELS];  // triad bandwidth in each cache level and DRAM
+} roofline_t;
+
+// Elements of data->a, b and c the bandwidth sweep needs
+int roofline_max_n(void);
+
+// Measure the peaks and sweep the bandwidth over working sets from L1 to
+// DRAM, printing both to out. config->min_time is raised to
+// ROOFLINE_MIN_TIME first, so the kernels timed with config afterwards run
+// under the same min_time and warmup as the ceilings.
+#define ROOFLINE_MIN_TIME 0.01
+void roofline_measure(roofline_t *roof, bench_data_t *data, bench_config_t *config, FILE *out);
+
+// Place each result on the roofline: the bound of a kernel is the lower of
+// the peak of its ISA and its nominal arithmetic intensity (flops_per_elem /
+// bytes_per_elem of the registry, not measured traffic) times the bandwidth
+// of the level its working set fits in. Results above their bound are
+// flagged rather than clamped.
+void roofline_place(FILE *out, const roofline_t *roof, const bench_result_t *results, int count);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "scale.h"
+
+// The kernel being timed on the team
+static struct {
+  team_t *team;
+  int threads;
+  void (*run)(bench_data_t *data, int N);
+  double *partial;  // bench_sink of each member
+} job;
+
+static void init_part(int member, size_t begin, size_t end, void *ctx) {
+  (void)member;
+  bench_init(begin, end, ctx);
+}
+
+static void run_part(int member, size_t begin, size_t end, void *ctx) {
+  bench_data_t *data = ctx;
+  bench_data_t part = {data->a + begin, data->b + begin, data->c + begin, data->d + begin, end - begin, 1};
+  job.run(&part, end - begin);
+  job.partial[member] = bench_sink;
+}
+
+// Reductions add up the results of the members in member order
+static void run_team(bench_data_t *data, int N) {
+  team_run(job.team, N, run_part, data);
+  double sum = 0;
+  for (int t = 0; t < job.threads; t++)
+    sum += job.partial[t];
+  bench_sink = sum;
+}
+
+static void report(FILE *out, bench_format_t format, const bench_result_t *r, int threads, double speedup,
+                   double efficiency, int first) {
+  switch (format) {
+    case FORMAT_TABLE:
+      fprintf(out, "%-10s %-12s %-7s %10d %7d %12.6g %9.3f %9.3f %8.2f %6.1f%%\n", bench_variant, r->kernel->name,
+              isa_name(r->isa), r->N, threads, r->median, r->gflops, r->gbs, speedup, 100 * efficiency);
+      break;
+    case FORMAT_CSV:
+      fprintf(out, "%s,%s,%s,%d,%d,%ld,%d,%.9g,%.9g,%.6g,%.6g,%.6g,%.6g\n", bench_variant, r->kernel->name,
+              isa_name(r->isa), r->N, threads, r->calls, r->reps, r->median, r->min, r->gflops, r->gbs, speedup,
+              efficiency);
+      break;
+    case FORMAT_JSON:
+      fprintf(out,
+              "%s  {\"variant\": \"%s\", \"kernel\": \"%s\", \"isa\": \"%s\", \"n\": %d, \"threads\": %d, "
+              "\"calls\": %ld, \"reps\": %d, \"median_s\": %.9g, \"min_s\": %.9g, \"gflops\": %.6g, "
+              "\"gbs\": %.6g, \"speedup\": %.6g, \"efficiency\": %.6g}",
+              first ? "" : ",\n", bench_variant, r->kernel->name, isa_name(r->isa), r->N, threads, r->calls,
+              r->reps, r->median, r->min, r->gflops, r->gbs, speedup, efficiency);
+      break;
+  }
+}
+
+int scale_sweep(FILE *out, bench_format_t format, const kernel_t **kernels, int num_kernels, const int *sizes,
+                int num_sizes, const int *threads, int num_threads, const bench_config_t *config, int all_isas,
+                int huge_pages) {
+  for (int k = 0; k < num_kernels; k++) {
+    if (kernels[k]->fixed_n)
+      fprintf(stderr, "Note: %s() only runs at N = %d, scale its one-pass form instead\n", kernels[k]->name,
+              kernels[k]->fixed_n);
+  }
+
+  switch (format) {
+    case FORMAT_TABLE:
+      fprintf(out, "%-10s %-12s %-7s %10s %7s %12s %9s %9s %8s %7s\n", "variant", "kernel", "isa", "N", "threads",
+              "median(s)", "GFLOP/s", "GB/s", "speedup", "eff.");
+      break;
+    case FORMAT_CSV:
+      fprintf(out, "variant,kernel,isa,n,threads,calls,reps,median_s,min_s,gflops,gbs,speedup,efficiency\n");
+      break;
+    case FORMAT_JSON:
+      fprintf(out, "[\n");
+      break;
+  }
+
+  // Median of the first thread count for each kernel and ISA (ISA_BUILD
+  // first) at the current size
+  double *base = malloc((size_t)num_kernels * (ISA_COUNT + 1) * sizeof(double));
+  job.partial = malloc(threads[num_threads - 1] * sizeof(double));
+  int first = 1, status = 0;
+  for (int i = 0; i < num_sizes && status == 0; i++) {
+    int N = sizes[i];
+    for (int j = 0; j < num_threads; j++) {
+      int T = threads[j];
+      arena_t arena;
+      size_t floats = arena_footprint((size_t)N * sizeof(float));
+      size_t doubles = arena_footprint((size_t)N * sizeof(double));
+      if (arena_init(&arena, 3 * floats + doubles, huge_pages) != 0) {
+        printf("Error: Cannot allocate %zu MB for N = %d.\n", (3 * floats + doubles) >> 20, N);
+        status = -1;
+        break;
+      }
+      team_t *team = team_create(T);
+      bench_data_t data;
+      data.a = arena_alloc(&arena, (size_t)N * sizeof(float));
+      data.b = arena_alloc(&arena, (size_t)N * sizeof(float));
+      data.d = arena_alloc(&arena, (size_t)N * sizeof(double));
+      data.c = arena_alloc(&arena, (size_t)N * sizeof(float));
+      data.capacity = N;
+      data.threads = 1;
+      data.team = NULL;
+      team_run(team, N, init_part, &data);
+      job.team = team;
+      job.threads = T;
+
+      for (int k = 0; k < num_kernels; k++) {
+        const kernel_t *kernel = kernels[k];
+        if (kernel->fixed_n)
+          continue;
+        for (int isa = 0; isa < (all_isas && kernel->clones[0] ? ISA_COUNT : 1); isa++) {
+          int chosen = all_isas ? isa : config->isa;
+          if (all_isas && !isa_supported(isa))
+            continue;
+
+          // The team runs the clone, so bench_run sees a kernel without clones
+          kernel_t on_team = *kernel;
+          on_team.run = run_team;
+          for (int c = 0; c < ISA_COUNT; c++)
+            on_team.clones[c] = NULL;
+          job.run = kernel->run;
+          if (chosen != ISA_BUILD && kernel->clones[chosen])
+            job.run = kernel->clones[chosen];
+          else
+            chosen = ISA_BUILD;
+          bench_config_t team_config = *config;
+          team_config.isa = ISA_BUILD;
+          bench_result_t result = bench_run(&on_team, &data, N, &team_config);
+          result.kernel = kernel;
+          result.isa = chosen;
+
+          double *baseline = &base[k * (ISA_COUNT + 1) + chosen + 1];
+          if (j == 0)
+            *baseline = result.median;
+          double speedup = *baseline / result.median;
+          report(out, format, &result, T, speedup, speedup * threads[0] / T, first);
+          first = 0;
+          fflush(out);
+        }
+      }
+      team_destroy(team);
+      arena_free(&arena);
+    }
+  }
+  if (format == FORMAT_JSON)
+    fprintf(out, "\n]\n");
+  free(job.partial);
+  free(base);
+  return status;
+}
@@ -0,0 +1,20 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdio.h>
+#include "bench.h"
+
+// Time each kernel at each size on pinned teams of each thread count, every
+// member running the kernel (or its ISA clones with all_isas) over a static
+// part of the arrays. The arrays are allocated and first written by the team
+// for every size and thread count, so each part lives on the NUMA node of
+// the member that runs over it. Speedup and parallel efficiency are relative
+// to the first thread count, which is the smallest.
+//
+// Kernels with a fixed N are skipped, their one-pass forms (add, max, sum)
+// scale instead. Returns 0, or -1 if the arrays cannot be allocated.
+int scale_sweep(FILE *out, bench_format_t format, const kernel_t **kernels, int num_kernels, const int *sizes,
+                int num_sizes, const int *threads, int num_threads, const bench_config_t *config, int all_isas,
+                int huge_pages);
+
+#endif
@@ -2,17 +2,49 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <immintrin.h>
 
+#define LCG_MUL 6364136223846793005ULL
+#define LCG_INC 1ULL
 
 static inline __attribute__((always_inline, hot))
 uint64_t fast_lcg(uint64_t *s) {
-    *s = (*s * 6364136223846793005ULL + 1ULL);  // 1 mul + 1 add
+    *s = (*s * LCG_MUL + LCG_INC);  // 1 mul + 1 add
     return *s;
 }
 
+// (mul, inc) of n LCG steps at once, s_n = mul * s_0 + inc, in O(log n)
+static void lcg_jump(uint64_t n, uint64_t *mul, uint64_t *inc) {
+    uint64_t acc_mul = 1, acc_inc = 0;
+    uint64_t cur_mul = LCG_MUL, cur_inc = LCG_INC;
+    for (; n; n >>= 1) {
+        if (n & 1) {
+            acc_mul *= cur_mul;
+            acc_inc = acc_inc * cur_mul + cur_inc;
+        }
+        cur_inc *= cur_mul + 1;
+        cur_mul *= cur_mul;
+    }
+    *mul = acc_mul;
+    *inc = acc_inc;
+}
+
+static inline uint64_t lcg_skip(uint64_t s, uint64_t n) {
+    uint64_t mul, inc;
+    lcg_jump(n, &mul, &inc);
+    return s * mul + inc;
+}
+
 static inline __attribute__((always_inline, hot))
 uint64_t mix64(uint64_t z) {
     z += 0x9E3779B97F4A7C15ULL;
@@ -34,6 +66,15 @@ uint64_t sqsum64(int32_t x, int32_t y) {
     return (uint64_t)(X*X) + (uint64_t)(Y*Y);
 }
 
+#define PI_R  2147483647LL                          // 2^31-1
+#define PI_R2 ((uint64_t)PI_R * (uint64_t)PI_R)
+
+// One toss per LCG output: x and y are its low and high 32 bits
+static inline __attribute__((always_inline, hot))
+int hit(uint64_t r) {
+    return sqsum64((int32_t)r, (int32_t)(r >> 32)) <= PI_R2;
+}
+
 static void* worker(void *arg) {
     Task *t = (Task*)arg;
     long long n = t->tosses;
@@ -88,45 +129,191 @@ static void* worker(void *arg) {
     return NULL;
 }
 
+/*
+ * SIMD workers: lane k of the vectors holds output k of the LCG and every
+ * step moves all lanes LANES outputs ahead (a leapfrog of the same
+ * generator). The vector workers therefore toss exactly the points of the
+ * scalar worker, in the same order, and count the same hits.
+ *
+ * x^2 + y^2 needs 64 bits: the squares come from a signed 32x32->64 multiply
+ * of each lane, and the sum is at most 2^63, so sum - 1 < R^2 compares right
+ * as a signed 64-bit number. Hits stay in vector accumulators until the end.
+ */
 
-int main(int argc, char **argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <num_threads:int> <num_tosses:long long>\n", argv[0]);
-        return 1;
+// The lanes left over at the end are tossed one by one
+static long long tail_hits(const uint64_t *lanes, long long left) {
+    long long hits = 0;
+    for (long long k = 0; k < left; ++k)
+        hits += hit(lanes[k]);
+    return hits;
+}
+
+#define AVX2_LANES 8
+
+__attribute__((target("avx2"))) static inline
+__m256i mul64_avx2(__m256i v, __m256i mlo, __m256i mhi) {
+    __m256i lo    = _mm256_mul_epu32(v, mlo);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v, 32), mlo),
+                                     _mm256_mul_epu32(v, mhi));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// -1 in the lanes whose point is inside the circle
+__attribute__((target("avx2"))) static inline
+__m256i hits_avx2(__m256i r, __m256i r2) {
+    __m256i y  = _mm256_srli_epi64(r, 32);
+    __m256i ss = _mm256_add_epi64(_mm256_mul_epi32(r, r), _mm256_mul_epi32(y, y));
+    return _mm256_cmpgt_epi64(r2, _mm256_sub_epi64(ss, _mm256_set1_epi64x(1)));
+}
+
+__attribute__((target("avx2")))
+static void* worker_avx2(void *arg) {
+    Task *t = (Task*)arg;
+    long long n = t->tosses;
+    uint64_t st = t->state;
+
+    uint64_t lanes[AVX2_LANES] __attribute__((aligned(32)));
+    uint64_t s = st;
+    for (int k = 0; k < AVX2_LANES; ++k)
+        lanes[k] = fast_lcg(&s);
+    uint64_t mul, inc;
+    lcg_jump(AVX2_LANES, &mul, &inc);
+
+    const __m256i mlo = _mm256_set1_epi64x((long long)(mul & 0xFFFFFFFFULL));
+    const __m256i mhi = _mm256_set1_epi64x((long long)(mul >> 32));
+    const __m256i vin = _mm256_set1_epi64x((long long)inc);
+    const __m256i r2  = _mm256_set1_epi64x((long long)PI_R2);
+    __m256i v0 = _mm256_load_si256((const __m256i*)&lanes[0]);
+    __m256i v1 = _mm256_load_si256((const __m256i*)&lanes[4]);
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+
+    long long i = 0;
+    for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+        acc0 = _mm256_sub_epi64(acc0, hits_avx2(v0, r2));
+        acc1 = _mm256_sub_epi64(acc1, hits_avx2(v1, r2));
+        v0 = _mm256_add_epi64(mul64_avx2(v0, mlo, mhi), vin);
+        v1 = _mm256_add_epi64(mul64_avx2(v1, mlo, mhi), vin);
     }
-    int        num_threads = atoi(argv[1]);
-    long long  num_tosses  = atoll(argv[2]);
-    if (num_threads <= 0 || num_tosses < 0) {
-        fprintf(stderr, "Invalid arguments.\n");
-        return 1;
+
+    uint64_t sums[4] __attribute__((aligned(32)));
+    _mm256_store_si256((__m256i*)sums, _mm256_add_epi64(acc0, acc1));
+    _mm256_store_si256((__m256i*)&lanes[0], v0);
+    _mm256_store_si256((__m256i*)&lanes[4], v1);
+
+    t->state = lcg_skip(st, (uint64_t)n);
+    t->hits  = (long long)(sums[0] + sums[1] + sums[2] + sums[3]) + tail_hits(lanes, n - i);
+    return NULL;
+}
+
+#define AVX512_LANES 16
+
+__attribute__((target("avx512f,avx512dq")))
+static void* worker_avx512(void *arg) {
+    Task *t = (Task*)arg;
+    long long n = t->tosses;
+    uint64_t st = t->state;
+
+    uint64_t lanes[AVX512_LANES] __attribute__((aligned(64)));
+    uint64_t s = st;
+    for (int k = 0; k < AVX512_LANES; ++k)
+        lanes[k] = fast_lcg(&s);
+    uint64_t mul, inc;
+    lcg_jump(AVX512_LANES, &mul, &inc);
+
+    const __m512i vmul = _mm512_set1_epi64((long long)mul);
+    const __m512i vin  = _mm512_set1_epi64((long long)inc);
+    const __m512i r2   = _mm512_set1_epi64((long long)PI_R2);
+    const __m512i one  = _mm512_set1_epi64(1);
+    __m512i v0 = _mm512_load_si512(&lanes[0]);
+    __m512i v1 = _mm512_load_si512(&lanes[8]);
+    __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+
+    long long i = 0;
+    for (; i + AVX512_LANES <= n; i += AVX512_LANES) {
+        __m512i y0 = _mm512_srli_epi64(v0, 32), y1 = _mm512_srli_epi64(v1, 32);
+        __m512i ss0 = _mm512_add_epi64(_mm512_mul_epi32(v0, v0), _mm512_mul_epi32(y0, y0));
+        __m512i ss1 = _mm512_add_epi64(_mm512_mul_epi32(v1, v1), _mm512_mul_epi32(y1, y1));
+        acc0 = _mm512_mask_add_epi64(acc0, _mm512_cmple_epu64_mask(ss0, r2), acc0, one);
+        acc1 = _mm512_mask_add_epi64(acc1, _mm512_cmple_epu64_mask(ss1, r2), acc1, one);
+        v0 = _mm512_add_epi64(_mm512_mullo_epi64(v0, vmul), vin);
+        v1 = _mm512_add_epi64(_mm512_mullo_epi64(v1, vmul), vin);
     }
 
+    _mm512_store_si512(&lanes[0], v0);
+    _mm512_store_si512(&lanes[8], v1);
+
+    t->state = lcg_skip(st, (uint64_t)n);
+    t->hits  = _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1)) + tail_hits(lanes, n - i);
+    return NULL;
+}
+
+typedef struct {
+    const char *name;
+    void *(*fn)(void *);
+    int lanes;
+} Worker;
+
+static const Worker workers[] = {
+    {"scalar", worker,        1},
+    {"avx2",   worker_avx2,   AVX2_LANES},
+    {"avx512", worker_avx512, AVX512_LANES},
+};
+#define NUM_WORKERS ((int)(sizeof(workers) / sizeof(workers[0])))
+
+static int worker_supported(int w) {
+    __builtin_cpu_init();
+    switch (w) {
+    case 1:  return __builtin_cpu_supports("avx2");
+    case 2:  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+    default: return 1;
+    }
+}
+
+// The widest worker this CPU runs
+static int worker_best(void) {
+    int w = NUM_WORKERS - 1;
+    while (!worker_supported(w)) --w;
+    return w;
+}
+
+static double seconds(struct timespec a, struct timespec b) {
+    return (double)(b.tv_sec - a.tv_sec) + 1e-9 * (double)(b.tv_nsec - a.tv_nsec);
+}
+
+// Tosses that bring the standard error of pi under precision whatever pi is:
+// Var(4 hits/n) = 16 p (1 - p) / n <= 4 / n
+static long long tosses_for(double precision) {
+    return (long long)ceil(4.0 / (precision * precision));
+}
+
+/* ---------- one-shot: a thread per share, created for the run ---------- */
+
+static long long run_once(int w, int num_threads, long long num_tosses, uint64_t base_seed) {
     pthread_t *ths = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)num_threads);
-    if (!ths) { perror("alloc ths"); return 1; }
+    if (!ths) { perror("alloc ths"); exit(1); }
 
     size_t need  = sizeof(Task) * (size_t)num_threads;
     size_t bytes = (need + 63) & ~((size_t)63);
     Task *tasks = (Task*)aligned_alloc(64, bytes);
-    if (!tasks) { perror("aligned_alloc"); return 1; }
+    if (!tasks) { perror("aligned_alloc"); exit(1); }
 
     long long base = num_tosses / num_threads;
     int       rem  = (int)(num_tosses % num_threads);
 
-    // struct timespec ts;
-    // clock_gettime(CLOCK_REALTIME, &ts);
-    // uint64_t base_seed = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 16);
-    uint64_t base_seed = getpid();
+    // All threads toss from one stream: thread i skips ahead to its first
+    // toss, so the tosses and the hits do not depend on the thread count
+    uint64_t stream = mix64(base_seed);
+    long long first = 0;
 
     for (int i = 0; i < num_threads; ++i) {
         tasks[i].tosses = base + (i < rem ? 1 : 0);
-        uint64_t si = mix64(base_seed ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1)));
-        if (si == 0) si = 0x106689D45497FDB5ULL;   // LCG 狀態不可為 0
-        tasks[i].state = si;
-        tasks[i].hits  = 0;
+        tasks[i].state  = lcg_skip(stream, (uint64_t)first);
+        tasks[i].hits   = 0;
+        first += tasks[i].tosses;
 
-        if (pthread_create(&ths[i], NULL, worker, &tasks[i]) != 0) {
+        if (pthread_create(&ths[i], NULL, workers[w].fn, &tasks[i]) != 0) {
             perror("pthread_create");
-            return 1;
+            exit(1);
         }
     }
 
@@ -138,8 +325,699 @@ int main(int argc, char **argv) {
 
     free(ths);
     free(tasks);
+    return total_hits;
+}
+
+// Pin thread i to CPU i mod the online CPUs where the system lets us
+// (errors are ignored)
+static void pin_thread(pthread_t th, int i) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET((int)(i % ncpu), &cpuset);
+    pthread_setaffinity_np(th, sizeof(cpu_set_t), &cpuset);
+}
+
+/*
+ * Chunked mode: the tosses are cut into chunks of the stream. With static
+ * scheduling thread i runs chunks i, i + T, i + 2T, ...; with dynamic
+ * scheduling each thread takes the next chunk from an atomic counter, so
+ * threads on busy or slower cores simply take fewer chunks. The hits of a
+ * chunk do not depend on who tosses it, so both give the same estimate.
+ *
+ * Each thread publishes its progress in its own padded slot. For adaptive
+ * precision the thread that finishes a chunk also grows the prefix of
+ * finished chunks 0, 1, 2, ... and raises the stop flag at the first prefix
+ * whose binomial (Wilson) confidence interval is narrow enough. The estimate
+ * uses exactly that prefix, so it depends on the seed and the target only,
+ * not on the thread count, the scheduling or timing. Chunks past it are
+ * wasted work, so no thread starts a chunk more than one round of chunks
+ * (one per thread) past the prefix; smaller chunks (-k) waste less.
+ */
+
+#define CHUNK_DEFAULT    (1LL << 18)   // tosses per chunk
+#define CHUNK_MAX_CHUNKS (1LL << 22)   // larger runs get larger chunks
+
+typedef struct {
+    _Atomic long long chunks;   // chunks this thread finished
+    _Atomic long long hits;     // their hits
+    long long         tosses;   // written by the thread when it is done
+    double            busy;     // seconds from start to its last chunk
+    char              pad[64];
+} __attribute__((aligned(64))) Slot;
+
+static struct {
+    int            w;
+    int            threads;
+    int            dynamic;
+    long long      tosses;
+    long long      chunk;
+    long long      num_chunks;
+    uint64_t       stream;
+    long long     *chunk_hits;
+    Slot          *slots;
+    _Atomic long long next;     // next chunk with dynamic scheduling
+    _Atomic int    stop;
+    struct timespec start;
+
+    // Adaptive target and the finished prefix, under lock
+    double          z, halfwidth;
+    pthread_mutex_t lock;
+    pthread_cond_t  progress;   // the prefix grew, or stop
+    char           *chunk_done;
+    long long       prefix, prefix_hits, prefix_tosses;
+} chunked = {.lock = PTHREAD_MUTEX_INITIALIZER, .progress = PTHREAD_COND_INITIALIZER};
+
+typedef struct {
+    int       index;
+    pthread_t id;
+} ChunkThread;
+
+static long long chunk_tosses(long long k) {
+    long long first = k * chunked.chunk;
+    return (chunked.tosses - first < chunked.chunk) ? chunked.tosses - first : chunked.chunk;
+}
+
+// Half width of the Wilson score interval of pi = 4 p after hits of n
+static double wilson_halfwidth(long long hits, long long n, double z) {
+    if (n == 0) return INFINITY;
+    double p = (double)hits / (double)n, z2n = z * z / (double)n;
+    return 4.0 * z * sqrt(p * (1 - p) / (double)n + z2n / (4.0 * (double)n)) / (1 + z2n);
+}
+
+// Wait until chunk k is within one round of the prefix, or stop. Returns
+// whether to toss it.
+static int chunk_wait(long long k) {
+    pthread_mutex_lock(&chunked.lock);
+    while (k >= chunked.prefix + chunked.threads && !atomic_load(&chunked.stop))
+        pthread_cond_wait(&chunked.progress, &chunked.lock);
+    pthread_mutex_unlock(&chunked.lock);
+    return !atomic_load(&chunked.stop);
+}
+
+// Record chunk k, grow the prefix over finished chunks and stop at the first
+// prefix that meets the target
+static void chunk_commit(long long k, long long hits) {
+    pthread_mutex_lock(&chunked.lock);
+    chunked.chunk_hits[k] = hits;
+    chunked.chunk_done[k] = 1;
+    long long prefix = chunked.prefix;
+    while (prefix < chunked.num_chunks && chunked.chunk_done[prefix] && !atomic_load(&chunked.stop)) {
+        chunked.prefix_hits += chunked.chunk_hits[prefix];
+        chunked.prefix_tosses += chunk_tosses(prefix);
+        ++prefix;
+        if (wilson_halfwidth(chunked.prefix_hits, chunked.prefix_tosses, chunked.z) <= chunked.halfwidth)
+            atomic_store(&chunked.stop, 1);
+    }
+    if (prefix != chunked.prefix || atomic_load(&chunked.stop)) {
+        chunked.prefix = prefix;
+        pthread_cond_broadcast(&chunked.progress);
+    }
+    pthread_mutex_unlock(&chunked.lock);
+}
+
+static void* chunk_thread(void *arg) {
+    int i = ((ChunkThread*)arg)->index;
+    Slot *slot = &chunked.slots[i];
+    Task t __attribute__((aligned(64)));
+    long long tosses = 0;
+    int adaptive = chunked.z > 0;
+    for (long long j = 0; !atomic_load_explicit(&chunked.stop, memory_order_relaxed); ++j) {
+        long long k = chunked.dynamic ? atomic_fetch_add_explicit(&chunked.next, 1, memory_order_relaxed)
+                                      : i + j * chunked.threads;
+        if (k >= chunked.num_chunks || (adaptive && !chunk_wait(k))) break;
+        t.tosses = chunk_tosses(k);
+        t.state  = lcg_skip(chunked.stream, (uint64_t)(k * chunked.chunk));
+        t.hits   = 0;
+        workers[chunked.w].fn(&t);
+        tosses += t.tosses;
+        if (adaptive)
+            chunk_commit(k, t.hits);
+        else
+            chunked.chunk_hits[k] = t.hits;
+        atomic_fetch_add_explicit(&slot->hits, t.hits, memory_order_relaxed);
+        atomic_fetch_add_explicit(&slot->chunks, 1, memory_order_relaxed);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    slot->tosses = tosses;
+    slot->busy   = seconds(chunked.start, now);
+    return NULL;
+}
+
+// Toss max_tosses in chunks on pinned threads, or with z > 0 only until the
+// interval of pi at z is at most halfwidth wide on each side. Returns the
+// hits and sets *used to the tosses they are out of. The per-thread stats
+// stay in chunked.slots until the next run.
+static long long run_chunks(int w, int num_threads, long long max_tosses, uint64_t base_seed, long long chunk,
+                            int dynamic, double z, double halfwidth, long long *used) {
+    free(chunked.slots);
+    chunked.w          = w;
+    chunked.threads    = num_threads;
+    chunked.dynamic    = dynamic;
+    chunked.tosses     = max_tosses;
+    chunked.chunk      = chunk;
+    while ((max_tosses + chunked.chunk - 1) / chunked.chunk > CHUNK_MAX_CHUNKS) chunked.chunk *= 2;
+    chunked.num_chunks = (max_tosses + chunked.chunk - 1) / chunked.chunk;
+    chunked.stream     = mix64(base_seed);
+    chunked.chunk_hits = (long long*)malloc(sizeof(long long) * (size_t)(chunked.num_chunks + 1));
+    chunked.chunk_done = (char*)calloc((size_t)(chunked.num_chunks + 1), 1);
+    chunked.slots      = (Slot*)aligned_alloc(64, sizeof(Slot) * (size_t)num_threads);
+    ChunkThread *ths   = (ChunkThread*)malloc(sizeof(ChunkThread) * (size_t)num_threads);
+    if (!chunked.chunk_hits || !chunked.chunk_done || !chunked.slots || !ths) { perror("alloc"); exit(1); }
+    atomic_init(&chunked.next, 0);
+    atomic_init(&chunked.stop, 0);
+    chunked.z             = z;
+    chunked.halfwidth     = halfwidth;
+    chunked.prefix        = 0;
+    chunked.prefix_hits   = 0;
+    chunked.prefix_tosses = 0;
+    clock_gettime(CLOCK_MONOTONIC, &chunked.start);
+    for (int i = 0; i < num_threads; ++i) {
+        atomic_init(&chunked.slots[i].chunks, 0);
+        atomic_init(&chunked.slots[i].hits, 0);
+        ths[i].index = i;
+        if (pthread_create(&ths[i].id, NULL, chunk_thread, &ths[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+        pin_thread(ths[i].id, i);
+    }
+
+    for (int i = 0; i < num_threads; ++i) pthread_join(ths[i].id, NULL);
+
+    // Without a target every chunk runs and counts
+    long long hits = chunked.prefix_hits, n = chunked.prefix_tosses;
+    for (long long k = 0; z <= 0 && k < chunked.num_chunks; ++k) {
+        hits += chunked.chunk_hits[k];
+        n += chunk_tosses(k);
+    }
+    *used = n;
+    free(ths);
+    free(chunked.chunk_done);
+    free(chunked.chunk_hits);
+    return hits;
+}
+
+// Tosses run by the last run_chunks(), wasted ones included
+static long long chunks_done(void) {
+    long long done = 0;
+    for (int i = 0; i < chunked.threads; ++i) done += chunked.slots[i].tosses;
+    return done;
+}
+
+static void report_threads(FILE *out) {
+    fprintf(out, "%6s %8s %14s %10s %14s\n", "thread", "chunks", "tosses", "busy(s)", "tosses/s");
+    for (int i = 0; i < chunked.threads; ++i) {
+        const Slot *slot = &chunked.slots[i];
+        fprintf(out, "%6d %8lld %14lld %10.4f %14.4e\n", i, atomic_load(&slot->chunks), slot->tosses, slot->busy,
+                slot->busy > 0 ? (double)slot->tosses / slot->busy : 0.0);
+    }
+}
+
+/*
+ * Contention: hog threads spin until told to stop, pinned to the first
+ * CPUs, so the workers pinned next to them get only part of a core, like
+ * the slow cores of a hybrid CPU or a box shared with other jobs.
+ */
+
+static _Atomic int hogs_stop;
+
+static void* hog_thread(void *arg) {
+    (void)arg;
+    volatile unsigned long long spin = 0;
+    while (!atomic_load_explicit(&hogs_stop, memory_order_relaxed)) ++spin;
+    return NULL;
+}
+
+static pthread_t *hogs_start(int num_hogs) {
+    pthread_t *ids = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)(num_hogs + 1));
+    if (!ids) { perror("alloc hogs"); exit(1); }
+    atomic_init(&hogs_stop, 0);
+    for (int i = 0; i < num_hogs; ++i) {
+        if (pthread_create(&ids[i], NULL, hog_thread, NULL) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+        pin_thread(ids[i], i);
+    }
+    return ids;
+}
+
+static void hogs_stop_all(pthread_t *ids, int num_hogs) {
+    atomic_store(&hogs_stop, 1);
+    for (int i = 0; i < num_hogs; ++i) pthread_join(ids[i], NULL);
+    free(ids);
+}
+
+// Run the same tosses with static and dynamic chunks, with the hogs running
+static void compare_schedules(int w, int num_threads, long long num_tosses, uint64_t base_seed, long long chunk,
+                              int num_hogs) {
+    printf("%d threads, %lld tosses, %lld per chunk, %d hog threads\n", num_threads, num_tosses, chunk, num_hogs);
+    pthread_t *hogs = hogs_start(num_hogs);
+    for (int dynamic = 0; dynamic < 2; ++dynamic) {
+        struct timespec t0, t1;
+        long long used;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        long long hits = run_chunks(w, num_threads, num_tosses, base_seed, chunk, dynamic, 0, 0, &used);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        // Imbalance: how long the slowest thread worked over the average
+        double busy_max = 0, busy_sum = 0;
+        for (int i = 0; i < num_threads; ++i) {
+            busy_sum += chunked.slots[i].busy;
+            if (chunked.slots[i].busy > busy_max) busy_max = chunked.slots[i].busy;
+        }
+        printf("\n%s: %.4f s, pi %.6f (%lld hits), imbalance %.2f\n", dynamic ? "dynamic" : "static", seconds(t0, t1),
+               used > 0 ? 4.0 * (double)hits / (double)used : 0.0, hits,
+               busy_sum > 0 ? busy_max * num_threads / busy_sum : 1.0);
+        report_threads(stdout);
+    }
+    hogs_stop_all(hogs, num_hogs);
+    free(chunked.slots);
+    chunked.slots = NULL;
+}
+
+/*
+ * Pool mode: pinned threads live for the whole process and take parts of
+ * jobs from one queue. A job is cut into up to one part per thread (fewer
+ * for small jobs) on the same stream offsets as run_once(), so a job gives
+ * the same hits as a one-shot run with its seed. The thread that finishes
+ * the last part of a job writes its result line.
+ */
+
+#define POOL_MIN_PART (1LL << 16)   // smaller jobs are not split
+
+typedef struct {
+    int       fd;        // results go here, -1 to drop them
+    long long pending;   // jobs submitted and not answered, under pool.lock
+} Conn;
+
+typedef struct {
+    long long        id;
+    long long        tosses;
+    uint64_t         seed;
+    Conn            *conn;
+    struct timespec  submitted;
+    _Atomic long long hits;
+    _Atomic int       parts_left;
+} Job;
+
+typedef struct Part {
+    Job         *job;
+    long long    first;
+    long long    tosses;
+    struct Part *next;
+} Part;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  work;   // parts queued, or quit
+    pthread_cond_t  idle;   // a Conn has no pending jobs
+    Part           *head, *tail;
+    int             quit;
+    int             threads;
+    int             w;
+    pthread_t      *ids;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0, 0, 0, NULL};
+
+static void job_finish(Job *job) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long hits = atomic_load(&job->hits);
+    double pi = (job->tosses > 0) ? (4.0 * (double)hits / (double)job->tosses) : 0.0;
+
+    char line[160];
+    int len = snprintf(line, sizeof(line), "%lld %.6f %lld %lld %.1f\n", job->id, pi, hits, job->tosses,
+                       1e6 * seconds(job->submitted, now));
+
+    // Write outside the lock so a slow reader only holds up this thread; the
+    // job stays pending until then, so the connection cannot close under us
+    pthread_mutex_lock(&pool.lock);
+    int fd = job->conn->fd;
+    pthread_mutex_unlock(&pool.lock);
+    int gone = fd >= 0 && write(fd, line, (size_t)len) < 0;
+
+    pthread_mutex_lock(&pool.lock);
+    if (gone) job->conn->fd = -1;   // reader went away
+    if (--job->conn->pending == 0) pthread_cond_broadcast(&pool.idle);
+    pthread_mutex_unlock(&pool.lock);
+    free(job);
+}
+
+static void* pool_thread(void *arg) {
+    (void)arg;
+    Task t __attribute__((aligned(64)));
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.head && !pool.quit) pthread_cond_wait(&pool.work, &pool.lock);
+        Part *p = pool.head;
+        if (p) {
+            pool.head = p->next;
+            if (!pool.head) pool.tail = NULL;
+        }
+        pthread_mutex_unlock(&pool.lock);
+        if (!p) return NULL;
+
+        Job *job = p->job;
+        t.tosses = p->tosses;
+        t.state  = lcg_skip(mix64(job->seed), (uint64_t)p->first);
+        t.hits   = 0;
+        free(p);
+        workers[pool.w].fn(&t);
+        atomic_fetch_add(&job->hits, t.hits);
+        if (atomic_fetch_sub(&job->parts_left, 1) == 1) job_finish(job);
+    }
+}
+
+static void pool_start(int w, int num_threads) {
+    pool.w       = w;
+    pool.threads = num_threads;
+    pool.ids     = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)num_threads);
+    if (!pool.ids) { perror("alloc pool"); exit(1); }
+    for (int i = 0; i < num_threads; ++i) {
+        if (pthread_create(&pool.ids[i], NULL, pool_thread, NULL) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+        pin_thread(pool.ids[i], i);
+    }
+}
+
+static void pool_stop(void) {
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < pool.threads; ++i) pthread_join(pool.ids[i], NULL);
+    free(pool.ids);
+}
+
+static void pool_submit(Conn *conn, long long id, long long tosses, uint64_t seed) {
+    Job *job = (Job*)malloc(sizeof(Job));
+    if (!job) { perror("alloc job"); exit(1); }
+    long long parts = tosses / POOL_MIN_PART;
+    if (parts > pool.threads) parts = pool.threads;
+    if (parts < 1) parts = 1;
+    job->id     = id;
+    job->tosses = tosses;
+    job->seed   = seed;
+    job->conn   = conn;
+    atomic_init(&job->hits, 0);
+    atomic_init(&job->parts_left, (int)parts);
+    clock_gettime(CLOCK_MONOTONIC, &job->submitted);
+
+    long long base = tosses / parts, rem = tosses % parts, first = 0;
+    pthread_mutex_lock(&pool.lock);
+    conn->pending++;
+    for (long long i = 0; i < parts; ++i) {
+        Part *p = (Part*)malloc(sizeof(Part));
+        if (!p) { perror("alloc part"); exit(1); }
+        p->job    = job;
+        p->first  = first;
+        p->tosses = base + (i < rem ? 1 : 0);
+        p->next   = NULL;
+        first += p->tosses;
+        if (pool.tail) pool.tail->next = p; else pool.head = p;
+        pool.tail = p;
+    }
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_wait(Conn *conn) {
+    pthread_mutex_lock(&pool.lock);
+    while (conn->pending > 0) pthread_cond_wait(&pool.idle, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Read jobs, one per line: "tosses [seed [precision]]". Jobs without a seed
+// get base_seed + their line number; a precision (standard error of pi)
+// caps the tosses, and with 0 tosses sets them. Results are written to out
+// as "line pi hits tosses latency_us", in the order the jobs finish.
+static void serve(FILE *in, int out, uint64_t base_seed) {
+    Conn conn = {out, 0};
+    char *line = NULL;
+    size_t cap = 0;
+    long long id = 0;
+    while (getline(&line, &cap, in) > 0) {
+        ++id;
+        long long tosses;
+        unsigned long long seed = base_seed + (uint64_t)id;
+        double precision = 0;
+        int fields = sscanf(line, "%lld %llu %lf", &tosses, &seed, &precision);
+        if (fields < 1 || tosses < 0) {
+            if (line[strspn(line, " \t\r\n")] != '\0' && line[0] != '#')
+                fprintf(stderr, "line %lld: expected \"tosses [seed [precision]]\"\n", id);
+            continue;
+        }
+        if (precision > 0 && (tosses == 0 || tosses_for(precision) < tosses))
+            tosses = tosses_for(precision);
+        pool_submit(&conn, id, tosses, seed);
+    }
+    free(line);
+    pool_wait(&conn);
+}
+
+// Serve each connection to a Unix socket at path in turn, until killed
+static int serve_socket(const char *path, uint64_t base_seed) {
+    int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (srv < 0 || strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Cannot listen on %s.\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(srv, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(srv, 16) != 0) {
+        perror(path);
+        return 1;
+    }
+    for (;;) {
+        int fd = accept(srv, NULL, NULL);
+        if (fd < 0) continue;
+        FILE *in = fdopen(dup(fd), "r");
+        if (in) {
+            serve(in, fd, base_seed);
+            fclose(in);
+        }
+        close(fd);
+    }
+}
+
+/* ---------- latency benchmark: one-shot threads against the pool ---------- */
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void report_latency(const char *mode, double *lat, int reps) {
+    qsort(lat, (size_t)reps, sizeof(double), compare_double);
+    double sum = 0;
+    for (int r = 0; r < reps; ++r) sum += lat[r];
+    printf("%-7s %10.1f %10.1f %10.1f %10.1f\n", mode, 1e6 * sum / reps, 1e6 * lat[reps / 2],
+           1e6 * lat[(reps * 99) / 100], 1e6 * lat[reps - 1]);
+}
+
+static void bench_latency(int w, int num_threads, long long num_tosses, int reps, uint64_t base_seed) {
+    double *lat = (double*)malloc(sizeof(double) * (size_t)reps);
+    if (!lat) { perror("alloc"); exit(1); }
+    struct timespec t0, t1;
+    printf("%d threads, %lld tosses per job, %d jobs, latency in us\n", num_threads, num_tosses, reps);
+    printf("%-7s %10s %10s %10s %10s\n", "mode", "mean", "median", "p99", "max");
+
+    for (int r = 0; r < reps; ++r) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        run_once(w, num_threads, num_tosses, base_seed + (uint64_t)r);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        lat[r] = seconds(t0, t1);
+    }
+    report_latency("cold", lat, reps);
+
+    // Jobs go one at a time, like the one-shot runs
+    pool_start(w, num_threads);
+    Conn conn = {-1, 0};
+    for (int r = 0; r < reps; ++r) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        pool_submit(&conn, r, num_tosses, base_seed + (uint64_t)r);
+        pool_wait(&conn);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        lat[r] = seconds(t0, t1);
+    }
+    pool_stop();
+    report_latency("pooled", lat, reps);
+    free(lat);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-w scalar|avx2|avx512] [-s seed] [-v] [-d] [-k chunk] [-x hogs] <num_threads:int> "
+            "<num_tosses:long long>\n", prog);
+    fprintf(stderr, "       %s [-w ...] [-s seed] [-v] [-d] [-k chunk] [-x hogs] -e <se>|-c <ci> <num_threads:int> "
+            "<max_tosses:long long>\n", prog);
+    fprintf(stderr, "       %s [-w ...] [-s seed] [-k chunk] [-x hogs] -S <num_threads:int> <num_tosses:long long>\n",
+            prog);
+    fprintf(stderr, "       %s [-w ...] [-s seed] -p|-u <socket> <num_threads:int>\n", prog);
+    fprintf(stderr, "       %s [-w ...] [-s seed] -b <jobs> <num_threads:int> <num_tosses:long long>\n", prog);
+    fprintf(stderr, "  -w  worker to toss with (default: the widest this CPU runs)\n");
+    fprintf(stderr, "  -s  seed of the random stream; a seed gives the same hits on any thread count\n");
+    fprintf(stderr, "      and worker (default: the process id)\n");
+    fprintf(stderr, "  -v  report the worker, seed, hits and tosses/second per core on stderr\n");
+    fprintf(stderr, "  -e  toss until the standard error of pi is at most se\n");
+    fprintf(stderr, "  -c  toss until the 95%% confidence interval of pi is at most pi +- ci\n");
+    fprintf(stderr, "  -d  hand out chunks of tosses from a shared counter instead of a static split\n");
+    fprintf(stderr, "  -k  tosses per chunk with -d, -e, -c and -S (default: %lld)\n", CHUNK_DEFAULT);
+    fprintf(stderr, "  -x  run this many spinning threads pinned to the first CPUs meanwhile\n");
+    fprintf(stderr, "  -S  compare static and dynamic chunks, with per-thread tosses/second\n");
+    fprintf(stderr, "  -p  keep a pool of pinned threads and run the jobs read from stdin, one per\n");
+    fprintf(stderr, "      line as \"tosses [seed [precision]]\"; results are printed as\n");
+    fprintf(stderr, "      \"line pi hits tosses latency_us\" when each job finishes\n");
+    fprintf(stderr, "  -u  like -p, for each connection to a Unix socket at this path\n");
+    fprintf(stderr, "  -b  time this many jobs on new threads each and on the pool\n");
+}
+
+int main(int argc, char **argv) {
+    int w = worker_best();
+    int verbose = 0, batch = 0, bench_jobs = 0;
+    double z = 0, halfwidth = 0;   // adaptive target, z = 0 for a fixed toss count
+    int dynamic = 0, compare = 0, num_hogs = 0;
+    long long chunk = CHUNK_DEFAULT;
+    const char *socket_path = NULL;
+    uint64_t base_seed = getpid();
+    int opt;
+    while ((opt = getopt(argc, argv, "w:s:vpu:b:e:c:dk:x:S")) != -1) {
+        switch (opt) {
+        case 'w':
+            for (w = 0; w < NUM_WORKERS && strcmp(optarg, workers[w].name) != 0; ++w) {}
+            if (w == NUM_WORKERS || !worker_supported(w)) {
+                fprintf(stderr, "Worker %s is not available on this CPU.\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            base_seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'p':
+            batch = 1;
+            break;
+        case 'u':
+            socket_path = optarg;
+            break;
+        case 'b':
+            bench_jobs = atoi(optarg);
+            if (bench_jobs <= 0) {
+                fprintf(stderr, "Invalid number of jobs.\n");
+                return 1;
+            }
+            break;
+        case 'e':
+        case 'c':
+            z = (opt == 'e') ? 1.0 : 1.959964;
+            halfwidth = atof(optarg);
+            if (halfwidth <= 0) {
+                fprintf(stderr, "Invalid precision target.\n");
+                return 1;
+            }
+            break;
+        case 'd':
+            dynamic = 1;
+            break;
+        case 'k':
+            chunk = atoll(optarg);
+            if (chunk <= 0) {
+                fprintf(stderr, "Invalid chunk size.\n");
+                return 1;
+            }
+            break;
+        case 'x': {
+            // Up to a few per CPU, past that they only slow the machine down
+            long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+            num_hogs = atoi(optarg);
+            if (num_hogs < 0 || num_hogs > 4 * (ncpu < 1 ? 1 : ncpu)) {
+                fprintf(stderr, "Invalid number of hog threads.\n");
+                return 1;
+            }
+            break;
+        }
+        case 'S':
+            compare = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    int pooled = batch || socket_path;
+    if (argc - optind != (pooled ? 1 : 2)) {
+        usage(argv[0]);
+        return 1;
+    }
+    int        num_threads = atoi(argv[optind]);
+    long long  num_tosses  = pooled ? 0 : atoll(argv[optind + 1]);
+    if (num_threads <= 0 || num_tosses < 0) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+
+    if (pooled) {
+        // A reader that hangs up makes write() fail instead of killing us
+        signal(SIGPIPE, SIG_IGN);
+        pool_start(w, num_threads);
+        int status = 0;
+        if (socket_path)
+            status = serve_socket(socket_path, base_seed);
+        else
+            serve(stdin, STDOUT_FILENO, base_seed);
+        pool_stop();
+        return status;
+    }
+    if (bench_jobs) {
+        bench_latency(w, num_threads, num_tosses, bench_jobs, base_seed);
+        return 0;
+    }
+    if (compare) {
+        compare_schedules(w, num_threads, num_tosses, base_seed, chunk, num_hogs);
+        return 0;
+    }
+
+    // The plain run keeps the static split of one share per thread
+    pthread_t *hogs = hogs_start(num_hogs);
+    int in_chunks = dynamic || z > 0;
+    struct timespec t0, t1;
+    long long total_hits, used = num_tosses, done = num_tosses;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (in_chunks) {
+        total_hits = run_chunks(w, num_threads, num_tosses, base_seed, chunk, dynamic, z, halfwidth, &used);
+        done = chunks_done();
+    } else {
+        total_hits = run_once(w, num_threads, num_tosses, base_seed);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    hogs_stop_all(hogs, num_hogs);
+    num_tosses = used;
 
     double pi = (num_tosses > 0) ? (4.0 * (double)total_hits / (double)num_tosses) : 0.0;
     printf("%.6f\n", pi);    
+
+    if (verbose) {
+        // Threads beyond the online CPUs share cores
+        double secs  = seconds(t0, t1);
+        long   cpus  = sysconf(_SC_NPROCESSORS_ONLN);
+        int    cores = (cpus > 0 && cpus < num_threads) ? (int)cpus : num_threads;
+        fprintf(stderr, "worker %s (%d lanes), %d threads, seed %llu, %lld hits, %.3f s, %.3e tosses/s per core\n",
+                workers[w].name, workers[w].lanes, num_threads, (unsigned long long)base_seed, total_hits, secs,
+                secs > 0 ? (double)done / secs / cores : 0.0);
+        if (z > 0)
+            fprintf(stderr, "adaptive: %lld tosses used, %lld run, pi +- %.3g at z = %.2f (target %.3g)\n", used, done,
+                    wilson_halfwidth(total_hits, used, z), z, halfwidth);
+        if (in_chunks) report_threads(stderr);
+    }
+    free(chunked.slots);
     return 0;
 }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -28,6 +29,33 @@ static inline double u01(uint64_t *s) {
     return (xs64(s) >> 11) * (1.0 / 9007199254740992.0); // 2^53
 }
 
+/* --------- xorshift64 跳躍：O(log n) 步跳到第 n 個狀態 ---------- */
+// xorshift64 在 GF(2) 上是線性的：x_n = T^n x_0。矩陣以 64 個 column
+// （單位向量的像）表示，用平方法求 T^n。
+static uint64_t xs_apply(const uint64_t *m, uint64_t v) {
+    uint64_t r = 0;
+    for (int j = 0; v; ++j, v >>= 1)
+        if (v & 1) r ^= m[j];
+    return r;
+}
+
+static uint64_t xs64_skip(uint64_t s, uint64_t n) {
+    uint64_t m[64], sq[64];
+    for (int j = 0; j < 64; ++j) {
+        uint64_t x = 1ULL << j;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        m[j] = x;
+    }
+    for (; n; n >>= 1) {
+        if (n & 1) s = xs_apply(m, s);
+        for (int j = 0; j < 64; ++j) sq[j] = xs_apply(m, m[j]);
+        memcpy(m, sq, sizeof(m));
+    }
+    return s;
+}
+
 /* --------- 64-bit seed 混合（SplitMix64 風格） ---------- */
 static inline uint64_t mix64(uint64_t z) {
     z += 0x9E3779B97f4A7C15ULL;
@@ -55,13 +83,25 @@ static void* worker(void *arg) {
 
 /* ------------------------ main -------------------------- */
 int main(int argc, char **argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <num_threads:int> <num_tosses:long long>\n", argv[0]);
+    // -s seed：同一個 seed 在任何 thread 數下得到相同的命中數
+    int seeded = 0;
+    uint64_t seed = 0;
+    int opt, bad = 0;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') {
+            seed = strtoull(optarg, NULL, 0);
+            seeded = 1;
+        } else {
+            bad = 1;
+        }
+    }
+    if (bad || argc - optind != 2) {
+        fprintf(stderr, "Usage: %s [-s seed] <num_threads:int> <num_tosses:long long>\n", argv[0]);
         return 1;
     }
 
-    int num_threads = atoi(argv[1]);
-    long long num_tosses = atoll(argv[2]);
+    int num_threads = atoi(argv[optind]);
+    long long num_tosses = atoll(argv[optind + 1]);
     if (num_threads <= 0 || num_tosses < 0) {
         fprintf(stderr, "Invalid arguments.\n");
         return 1;
@@ -74,20 +114,24 @@ int main(int argc, char **argv) {
     long long base = num_tosses / num_threads;
     long long rem  = num_tosses % num_threads;
 
-    // 產生基礎 seed：時間秒/奈秒 + PID
+    // 產生基礎 seed：時間秒/奈秒 + PID（沒有 -s 時）
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
-    uint64_t base_seed = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 16);
+    uint64_t base_seed = seeded ? seed
+                                : ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 16);
+
+    // 所有 thread 共用同一條亂數流：每個 thread 跳到自己第一個丟點的位置
+    // （每次丟點用 2 個亂數），結果與 thread 數無關
+    uint64_t stream = mix64(base_seed);
+    // xorshift64* 的 state 不能是 0
+    if (stream == 0) stream = 0x106689D45497FDB5ULL;
+    long long first = 0;
 
     // 建立 threads
     for (int i = 0; i < num_threads; ++i) {
         tasks[i].tosses = base + (i < rem ? 1 : 0);
-
-        // 每個 thread 用不同 seed（混得很散）
-        uint64_t si = mix64(base_seed ^ (0x9E3779B97f4A7C15ULL * (uint64_t)(i + 1)));
-        // xorshift64* 的 state 不能是 0
-        if (si == 0) si = 0x106689D45497FDB5ULL;
-        tasks[i].state = si;
+        tasks[i].state  = xs64_skip(stream, 2 * (uint64_t)first);
+        first += tasks[i].tosses;
 
         tasks[i].hits = 0;
         if (pthread_create(&threads[i], NULL, worker, &tasks[i]) != 0) {
@@ -1,5 +1,5 @@
 // pi.c -- Pthreads Monte Carlo Pi (LCG-64, MMIX constants)
-// Usage: ./pi.out <num_threads:int> <num_tosses:long long>
+// Usage: ./pi.out [-s seed] <num_threads:int> <num_tosses:long long>
 // Output: one line with the estimated PI (e.g., 3.141592)
 
 #define _GNU_SOURCE
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <errno.h>
+#include <unistd.h>
 
 typedef unsigned long long ull;
 
@@ -27,11 +28,28 @@ static inline uint64_t splitmix64(uint64_t *x) {
 */
 typedef struct { uint64_t s; } lcg64_state;
 
+#define LCG_A 6364136223846793005ULL
+#define LCG_C 1442695040888963407ULL
+
 static inline uint64_t lcg64_next(lcg64_state *st) {
-    st->s = st->s * 6364136223846793005ULL + 1442695040888963407ULL;
+    st->s = st->s * LCG_A + LCG_C;
     return st->s;
 }
 
+/* 跳 n 步：X_n = A_n * X_0 + C_n，以平方法 O(log n) 求 (A_n, C_n) */
+static uint64_t lcg64_skip(uint64_t s, uint64_t n) {
+    uint64_t acc_a = 1, acc_c = 0, a = LCG_A, c = LCG_C;
+    for (; n; n >>= 1) {
+        if (n & 1) {
+            acc_a *= a;
+            acc_c = acc_c * a + c;
+        }
+        c *= a + 1;
+        a *= a;
+    }
+    return s * acc_a + acc_c;
+}
+
 /* 轉 [0,1) double：取高 53 bits / 2^53，避開低位相關性 */
 static inline double u01_double_lcg(lcg64_state *st) {
     return (lcg64_next(st) >> 11) * (1.0 / 9007199254740992.0);
@@ -81,17 +99,28 @@ void* worker(void* arg) {
 }
 
 int main(int argc, char** argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <num_threads:int> <num_tosses:long long>\n", argv[0]);
+    // -s seed：同一個 seed 在任何 thread 數下得到相同結果
+    int seeded = 0, bad = 0, opt;
+    uint64_t seed = 0;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') {
+            seed = strtoull(optarg, NULL, 0);
+            seeded = 1;
+        } else {
+            bad = 1;
+        }
+    }
+    if (bad || argc - optind != 2) {
+        fprintf(stderr, "Usage: %s [-s seed] <num_threads:int> <num_tosses:long long>\n", argv[0]);
         return 1;
     }
-    int num_threads = atoi(argv[1]);
+    int num_threads = atoi(argv[optind]);
     if (num_threads <= 0) { fprintf(stderr, "num_threads must be > 0\n"); return 1; }
 
     char* endp = NULL;
     errno = 0;
-    ull total_tosses = strtoull(argv[2], &endp, 10);
-    if (errno || endp == argv[2]) { fprintf(stderr, "invalid num_tosses\n"); return 1; }
+    ull total_tosses = strtoull(argv[optind + 1], &endp, 10);
+    if (errno || endp == argv[optind + 1]) { fprintf(stderr, "invalid num_tosses\n"); return 1; }
 
     pthread_t* th = (pthread_t*)malloc(sizeof(pthread_t) * num_threads);
     Task* tasks    = (Task*)malloc(sizeof(Task) * num_threads);
@@ -100,12 +129,15 @@ int main(int argc, char** argv) {
     ull base = total_tosses / (ull)num_threads;
     ull rem  = total_tosses % (ull)num_threads;
 
-    // 每執行緒獨立 seed（用 splitmix64 從全域種子衍生）
-    uint64_t g = (uint64_t)time(NULL) ^ 0xA5A5A5A5A5A5A5A5ULL;
+    // 所有執行緒共用一條亂數流（splitmix64 從全域種子導出），每個執行緒
+    // 跳到自己第一次丟點的位置（每次丟點用 2 個亂數）
+    uint64_t g = seeded ? seed : (uint64_t)time(NULL) ^ 0xA5A5A5A5A5A5A5A5ULL;
+    uint64_t stream = splitmix64(&g);
+    ull first = 0;
     for (int i = 0; i < num_threads; ++i) {
         tasks[i].tosses = base + (i < (int)rem ? 1 : 0);
-        uint64_t mix = (uint64_t)i * 0x9E3779B97F4A7C15ULL ^ g;
-        tasks[i].rng.s = splitmix64(&mix);
+        tasks[i].rng.s = lcg64_skip(stream, 2 * first);
+        first += tasks[i].tosses;
         tasks[i].local_hits = 0;
         pthread_create(&th[i], NULL, worker, &tasks[i]);
     }
@@ -18,6 +18,20 @@ uint64_t fast_lcg(uint64_t *s) {
     return *s;
 }
 
+/* ---------- LCG 跳躍：O(log n) 跳 n 步 ---------- */
+static uint64_t lcg_skip(uint64_t s, uint64_t n) {
+    uint64_t acc_a = 1, acc_c = 0, a = 6364136223846793005ULL, c = 1ULL;
+    for (; n; n >>= 1) {
+        if (n & 1) {
+            acc_a *= a;
+            acc_c = acc_c * a + c;
+        }
+        c *= a + 1;
+        a *= a;
+    }
+    return s * acc_a + acc_c;
+}
+
 /* ---------- 種子混合（SplitMix64 風格） ---------- */
 static inline __attribute__((always_inline, hot))
 uint64_t mix64(uint64_t z) {
@@ -110,12 +124,23 @@ static inline void bind_thread_to_cpu(pthread_t th, int cpu_id) {
 #endif
 
 int main(int argc, char **argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <num_threads:int> <num_tosses:long long>\n", argv[0]);
+    // -s seed：同一個 seed 在任何 thread 數下得到相同結果
+    int seeded = 0, bad = 0, opt;
+    uint64_t seed = 0;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') {
+            seed = strtoull(optarg, NULL, 0);
+            seeded = 1;
+        } else {
+            bad = 1;
+        }
+    }
+    if (bad || argc - optind != 2) {
+        fprintf(stderr, "Usage: %s [-s seed] <num_threads:int> <num_tosses:long long>\n", argv[0]);
         return 1;
     }
-    int        num_threads = atoi(argv[1]);
-    long long  num_tosses  = atoll(argv[2]);
+    int        num_threads = atoi(argv[optind]);
+    long long  num_tosses  = atoll(argv[optind + 1]);
     if (num_threads <= 0 || num_tosses < 0) {
         fprintf(stderr, "Invalid arguments.\n");
         return 1;
@@ -133,10 +158,14 @@ int main(int argc, char **argv) {
     long long base = num_tosses / num_threads;
     int       rem  = (int)(num_tosses % num_threads);
 
-    // 基礎 seed：時間 + PID，再用 mix64 打散，確保各 thread 種子不同且 ≠ 0
+    // 基礎 seed：-s 或時間 + PID，再用 mix64 打散成一條亂數流；各 thread
+    // 跳到自己第一次丟點的位置，結果與 thread 數無關
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
-    uint64_t base_seed = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 16);
+    uint64_t base_seed = seeded ? seed
+                                : ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 16);
+    uint64_t stream = mix64(base_seed);
+    long long first = 0;
 
 #ifdef __linux__
     long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
@@ -145,10 +174,9 @@ int main(int argc, char **argv) {
 
     for (int i = 0; i < num_threads; ++i) {
         tasks[i].tosses = base + (i < rem ? 1 : 0);
-        uint64_t si = mix64(base_seed ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1)));
-        if (si == 0) si = 0x106689D45497FDB5ULL;   // LCG 狀態不可為 0
-        tasks[i].state = si;
-        tasks[i].hits  = 0;
+        tasks[i].state  = lcg_skip(stream, (uint64_t)first);
+        tasks[i].hits   = 0;
+        first += tasks[i].tosses;
 
         if (pthread_create(&ths[i], NULL, worker, &tasks[i]) != 0) {
             perror("pthread_create");